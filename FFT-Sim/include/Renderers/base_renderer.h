@@ -12,7 +12,9 @@
 #include "../resource_manager.h"
 
 
-constexpr unsigned int FRAME_OVERLAP = 2;
+//Frame slots allocated up front, how many of them are in flight is picked at runtime
+constexpr unsigned int MAX_FRAMES_IN_FLIGHT = 4;
+constexpr unsigned int DEFAULT_FRAMES_IN_FLIGHT = 2;
 
 struct BaseRenderer
 {
@@ -4,13 +4,18 @@
 #include <stb_image.h>
 #include <VkBootstrap.h>
 
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <numeric>
 #include <chrono>
 #include <thread>
-#include <random>
 #include <iostream>
+#include <cstddef>
 
 #include <string>
 #include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
 using namespace std::literals::string_literals;
 
 #include <vk_mem_alloc.h>
@@ -24,98 +29,434 @@ using namespace std::literals::string_literals;
 
 float FFTRenderer::GetHeightValues(const double x, const double y, const double t)
 {
-	height_values.resize(ocean_params.resolution * ocean_params.resolution);
-	engine->immediate_submit([&](VkCommandBuffer cmd)
+	float height = 0.0f;
+	OceanPoint point{ float(x), float(y) };
+	GetHeights(&point, 1, t, &height);
+	return height;
+}
+
+void FFTRenderer::GetHeights(const OceanPoint* points, size_t count, double t, float* out)
+{
+	WaitHeights(RequestHeights(points, count, t), out);
+}
+
+HeightQueryTicket FFTRenderer::RequestHeights(const OceanPoint* points, size_t count, double t)
+{
+	HeightQueryTicket ticket;
+	ticket.id = next_query_ticket++;
+	ticket.slot = uint32_t(ticket.id % HeightQuerySlots());
+	HeightQuerySlot& slot = height_queries[ticket.slot];
+
+	//Ring is full, the oldest query has to land before its buffers can be reused. Its ticket expires uncollected
+	if (slot.pending)
+		WaitTimeline(graphics_timeline, slot.timeline_value);
+
+	slot.descriptors.clear_pools(engine->_device);
+	ReserveQueryBuffers(slot, count);
+	slot.count = count;
+	slot.ticket = ticket.id;
+	slot.pending = true;
+
+	//Points are uploaded once through the persistently mapped buffer
+	if (count != 0)
+	{
+		memcpy(slot.points.info.pMappedData, points, count * sizeof(OceanPoint));
+		vmaFlushAllocation(engine->_allocator, slot.points.allocation, 0, count * sizeof(OceanPoint));
+	}
+
+	VkCommandBufferBeginInfo cmdBeginInfo = vkinit::command_buffer_begin_info(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+	VkCommandBuffer cmd = slot.command_buffer;
+	VK_CHECK(vkResetCommandBuffer(cmd, 0));
+	VK_CHECK(vkBeginCommandBuffer(cmd, &cmdBeginInfo));
+
+	//Descriptors must live as long as this submission, not the current frame
+	descriptor_override = &slot.descriptors;
+	bool simulated = false;
+	uint64_t simulation_value = 0;
+	//A pending sea state applies to the frames as well and drops the last query result, the rest of the query leaves their state alone
+	if (sim_params.changed)
+		UpdateSeaState();
+	if (last_t != t || first_check)
+	{
+		first_check = false;
+		last_t = t;
+		simulated = true;
+		const FFTParams frame_params = ocean_params;
+		std::vector<CascadeRun> frame_runs = cascade_runs;
+		const uint32_t frame_scheduled = scheduled_cascades;
+		if (async_compute)
 		{
-			if (last_t != t || first_check)
-			{
-				first_check = false;
-				last_t = t;
-				vkutil::transition_image(cmd, surface.inital_spectrum_texture.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
-				vkutil::transition_image(cmd, surface.horizontal_map.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
-				vkutil::transition_image(cmd, surface.height_derivative.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
-				vkutil::transition_image(cmd, surface.ping_1.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
-				vkutil::transition_image(cmd, surface.gaussian_noise_texture.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
-				vkutil::transition_image(cmd, surface.wave_texture.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
-				vkutil::transition_image(cmd, surface.conjugated_spectrum_texture.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
-				vkutil::transition_image(cmd, surface.jacobian_XxZz_map.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
-				vkutil::transition_image(cmd, surface.jacobian_xz_map.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
-				vkutil::transition_image(cmd, surface.height_derivative_texture.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
-				vkutil::transition_image(cmd, surface.frequency_domain_texture.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
-				vkutil::transition_image(cmd, surface.horizontal_displacement_map.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
-				vkutil::transition_image(cmd, surface.height_map.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
-				vkutil::transition_image(cmd, surface.displacement_map.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
-
-				GenerateInitialSpectrum(cmd);
-
-				//PingPongPhasePass(cmd);
-				auto original_time = ocean_params.delta_time;
-				ocean_params.delta_time = t;
-				GenerateSpectrum(cmd, t);
-				ocean_params.delta_time = original_time;
-
-				sim_params.is_ping_phase = !sim_params.is_ping_phase;
-
-				//Perform FFT on frequency textures
-				DoIFFT(cmd, &surface.frequency_domain_texture, &surface.height_map);
-				DoIFFT(cmd, &surface.height_derivative_texture, &surface.height_derivative);
-				DoIFFT(cmd, &surface.horizontal_displacement_map, &surface.horizontal_map);
-				WrapSpectrum(cmd);
-
-				//Conjugate generated spectrum
-				VkDescriptorSet copy_buffer_set = get_current_frame()._frameDescriptors.allocate(engine->_device, height_copy_layout);
-				DescriptorWriter writer;
-
-				int resolution = ocean_params.resolution;
-				writer.write_image(0, surface.displacement_map.imageView, samplerLinear, VK_IMAGE_LAYOUT_GENERAL, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
-				writer.write_buffer(1, surface.height_buffer.buffer, resolution * resolution * sizeof(float), 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
-				writer.update_set(engine->_device, copy_buffer_set);
-
-				vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, copy_buffer_pso.pipeline);
-
-				vkCmdPushConstants(cmd, copy_buffer_pso.layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(int), &resolution);
-
-				vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, copy_buffer_pso.layout, 0, 1, &copy_buffer_set, 0, nullptr);
-
-				vkCmdDispatch(cmd, (surface.texture_dimensions / 32), (surface.texture_dimensions / 32), 1);
-			}
-			vkutil::transition_image(cmd, surface.displacement_map.image, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+			//Split like SubmitAsyncSimulation: spectrum and IFFT on the compute queue, the output maps stay with graphics
+			VkCommandBuffer compute_cmd = slot.compute_command_buffer;
+			VK_CHECK(vkResetCommandBuffer(compute_cmd, 0));
+			VK_CHECK(vkBeginCommandBuffer(compute_cmd, &cmdBeginInfo));
+			SimulateAt(compute_cmd, t);
+			VkImageMemoryBarrier ownership = SpatialFieldsOwnership();
+			vkCmdPipelineBarrier(compute_cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &ownership);
+			VK_CHECK(vkEndCommandBuffer(compute_cmd));
+
+			//Frames submitted so far may still wrap from spatial_fields
+			VkSemaphoreSubmitInfo frames_done = vkinit::semaphore_submit_info(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, graphics_timeline.semaphore);
+			frames_done.value = graphics_timeline.value;
+			simulation_value = SubmitTimeline(compute_timeline, compute_cmd, { frames_done });
+
+			vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &ownership);
+		}
+		else
+		{
+			SimulateAt(cmd, t);
+		}
+		vkutil::transition_image(cmd, surface.query_height_derivative.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+		vkutil::transition_image(cmd, surface.query_displacement_map.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+		WrapSpectrum(cmd, &surface.query_height_derivative, &surface.query_displacement_map);
 
-			//Conjugate generated spectrum
-			VkDescriptorSet sample_set = get_current_frame()._frameDescriptors.allocate(engine->_device, height_sample_layout);
-			DescriptorWriter writer;
+		ocean_params = frame_params;
+		cascade_runs = std::move(frame_runs);
+		scheduled_cascades = frame_scheduled;
+	}
 
-			int resolution = ocean_params.resolution;
-			glm::vec2 tex_coord = (glm::vec2(x,y) / float(resolution)) + 0.5f;
-			writer.write_image(0, surface.displacement_map.imageView, samplerLinear, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
-			writer.write_buffer(1, surface.height_buffer.buffer,sizeof(float), 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
-			writer.update_set(engine->_device, sample_set);
+	if (count != 0)
+	{
+		vkutil::transition_image(cmd, surface.query_displacement_map.image, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 
-			vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, lookup_value_pso.pipeline);
+		VkDescriptorSet sample_set = compute_descriptors().allocate(engine->_device, height_sample_layout);
+		DescriptorWriter writer;
+		writer.write_image(0, surface.query_displacement_map.imageView, samplerLinear, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+		writer.write_buffer(1, slot.points.buffer, count * sizeof(OceanPoint), 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+		writer.write_buffer(2, slot.heights.buffer, count * sizeof(float), 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+		writer.update_set(engine->_device, sample_set);
 
-			vkCmdPushConstants(cmd, lookup_value_pso.layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(glm::vec2), &tex_coord);
+		HeightSampleParams sample_params{ uint32_t(count), cascade_count };
+		std::copy(std::begin(ocean_params.cascade_sizes), std::end(ocean_params.cascade_sizes), sample_params.cascade_sizes);
 
-			vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, lookup_value_pso.layout, 0, 1, &sample_set, 0, nullptr);
+		vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, lookup_value_pso.pipeline);
 
-			vkCmdDispatch(cmd, 1, 1, 1);
+		vkCmdPushConstants(cmd, lookup_value_pso.layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(sample_params), &sample_params);
 
-			vkutil::transition_image(cmd, surface.displacement_map.image, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_GENERAL);
+		vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, lookup_value_pso.layout, 0, 1, &sample_set, 0, nullptr);
 
+		vkCmdDispatch(cmd, uint32_t((count + 63) / 64), 1, 1);
 
-	});
-	void* buffer_data;
-	vmaMapMemory(engine->_allocator, surface.height_buffer.allocation, &buffer_data);
-	memcpy(height_values.data(), buffer_data, ocean_params.resolution * ocean_params.resolution * sizeof(float));
-	vmaUnmapMemory(engine->_allocator, surface.height_buffer.allocation);
-	
+		vkutil::transition_image(cmd, surface.query_displacement_map.image, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_GENERAL);
+	}
+	descriptor_override = nullptr;
 
-	float height;
-	void* sampled_value;
-	vmaMapMemory(engine->_allocator, surface.sampled_value.allocation, &sampled_value);
-	memcpy(&height, buffer_data, sizeof(float));
-	vmaUnmapMemory(engine->_allocator, surface.sampled_value.allocation);
+	VK_CHECK(vkEndCommandBuffer(cmd));
 
-	return height;
+	//The wrap and sampling passes run on graphics in either mode, queue order puts them after the frames submitted so far
+	if (simulation_value != 0)
+	{
+		VkSemaphoreSubmitInfo simulation_done = vkinit::semaphore_submit_info(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, compute_timeline.semaphore);
+		simulation_done.value = simulation_value;
+		slot.timeline_value = SubmitTimeline(graphics_timeline, cmd, { simulation_done });
+	}
+	else
+	{
+		slot.timeline_value = SubmitTimeline(graphics_timeline, cmd, {});
+	}
+	//The next async simulation must not overwrite spatial_fields before this wrap has read them
+	if (simulated)
+		last_wrap_value = slot.timeline_value;
+
+	return ticket;
+}
+
+HeightQueryStatus FFTRenderer::TryGetHeights(const HeightQueryTicket& ticket, float* out)
+{
+	HeightQuerySlot& slot = height_queries[ticket.slot];
+
+	//Stale tickets never complete, their slot has been handed to a newer query
+	if (ticket.id == 0 || slot.ticket != ticket.id)
+		return HeightQueryStatus::Expired;
+
+	uint64_t completed = 0;
+	VK_CHECK(vkGetSemaphoreCounterValue(engine->_device, graphics_timeline.semaphore, &completed));
+	if (completed < slot.timeline_value)
+		return HeightQueryStatus::Pending;
+
+	slot.pending = false;
+	if (slot.count != 0)
+	{
+		vmaInvalidateAllocation(engine->_allocator, slot.heights.allocation, 0, slot.count * sizeof(float));
+		memcpy(out, slot.heights.info.pMappedData, slot.count * sizeof(float));
+	}
+	return HeightQueryStatus::Ready;
+}
+
+HeightQueryStatus FFTRenderer::WaitHeights(const HeightQueryTicket& ticket, float* out)
+{
+	HeightQuerySlot& slot = height_queries[ticket.slot];
+	if (ticket.id == 0 || slot.ticket != ticket.id)
+		return HeightQueryStatus::Expired;
+
+	WaitTimeline(graphics_timeline, slot.timeline_value);
+	return TryGetHeights(ticket, out);
+}
+
+void FFTRenderer::Simulate(double t)
+{
+	//A query without points only records the simulation passes
+	WaitHeights(RequestHeights(nullptr, 0, t), nullptr);
+}
+
+void FFTRenderer::ReadDisplacementMap(std::vector<float>& out)
+{
+	const uint32_t RES = surface.texture_dimensions;
+	const size_t value_count = size_t(RES) * RES * 4;
+	const size_t byte_size = value_count * (half_precision ? sizeof(uint16_t) : sizeof(float));
+	AllocatedBuffer readback = resource_manager->CreateBuffer(byte_size, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_TO_CPU, "displacement readback");
+
+	//First cascade only, the layer the CPU reference simulates. Simulate leaves the map in the general layout
+	engine->immediate_submit([&](VkCommandBuffer cmd) {
+		vkutil::transition_image(cmd, surface.query_displacement_map.image, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+
+		VkBufferImageCopy copy{};
+		copy.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		copy.imageSubresource.layerCount = 1;
+		copy.imageExtent = { RES, RES, 1 };
+		vkCmdCopyImageToBuffer(cmd, surface.query_displacement_map.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, readback.buffer, 1, &copy);
+
+		vkutil::transition_image(cmd, surface.query_displacement_map.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_GENERAL);
+		});
+
+	out.resize(value_count);
+	vmaInvalidateAllocation(engine->_allocator, readback.allocation, 0, byte_size);
+	if (half_precision)
+	{
+		const uint16_t* halves = static_cast<const uint16_t*>(readback.info.pMappedData);
+		for (size_t i = 0; i < value_count; i++)
+			out[i] = glm::unpackHalf1x16(halves[i]);
+	}
+	else
+		memcpy(out.data(), readback.info.pMappedData, byte_size);
+	resource_manager->DestroyBuffer(readback);
+}
+
+double FFTRenderer::ElapsedTime()
+{
+	//GLFW is never initialised in headless mode
+	if (headless)
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+	return glfwGetTime();
+}
+
+bool FFTRenderer::SetResolution(uint32_t resolution)
+{
+	bool power_of_two = resolution != 0 && (resolution & (resolution - 1)) == 0;
+	if (_isInitialized || !power_of_two || resolution < MIN_FFT_RESOLUTION || resolution > MAX_FFT_RESOLUTION)
+	{
+		std::cout << "Unsupported FFT resolution " << resolution << ", keeping " << surface.texture_dimensions << std::endl;
+		return false;
+	}
+	surface.texture_dimensions = resolution;
+	return true;
+}
+
+bool FFTRenderer::SetHalfPrecision(bool enabled)
+{
+	if (_isInitialized)
+	{
+		std::cout << "Storage precision can only change before init" << std::endl;
+		return false;
+	}
+	half_precision = enabled;
+	return true;
+}
+
+bool FFTRenderer::SetCascadeCount(uint32_t count)
+{
+	if (_isInitialized || count < 1 || count > MAX_CASCADES)
+	{
+		std::cout << "Unsupported cascade count " << count << ", keeping " << cascade_count << std::endl;
+		return false;
+	}
+	cascade_count = count;
+	//Every halving of the patch size halves the update period, the largest patches hold the slowest waves
+	for (uint32_t cascade = 0; cascade < MAX_CASCADES; cascade++)
+		cascades[cascade].period = cascade < count ? std::min(1u << (count - 1 - cascade), 4u) : 1u;
+	cascade_offsets_dirty = true;
+	return true;
+}
+
+bool FFTRenderer::SetCascadeUpdatePeriod(uint32_t cascade, uint32_t period)
+{
+	bool power_of_two = period != 0 && (period & (period - 1)) == 0;
+	if (cascade >= cascade_count || !power_of_two || period > MAX_CASCADE_PERIOD)
+	{
+		std::cout << "Unsupported update period " << period << " for cascade " << cascade << std::endl;
+		return false;
+	}
+	cascades[cascade].period = period;
+	cascade_offsets_dirty = true;
+	return true;
+}
+
+bool FFTRenderer::SetSimulationRate(float hz)
+{
+	if (hz != 0.0f && (hz < MIN_SIMULATION_RATE || hz > MAX_SIMULATION_RATE))
+	{
+		std::cout << "Unsupported simulation rate " << hz << " Hz, keeping " << simulation_rate << std::endl;
+		return false;
+	}
+	simulation_rate = hz;
+	//The updates kept so far were scheduled for the other mode
+	cascade_history_valid = false;
+	return true;
+}
+
+bool FFTRenderer::SetFramesInFlight(uint32_t count)
+{
+	if (count < 1 || count > MAX_FRAMES_IN_FLIGHT)
+	{
+		std::cout << "Unsupported frames in flight " << count << ", keeping " << frames_in_flight << std::endl;
+		return false;
+	}
+	//Each slot waits for its own last submission, so the rotation may shrink or grow between two frames.
+	//Slots left out of it are never flushed by Draw again, their UBOs and descriptor sets are released here
+	if (_isInitialized)
+	{
+		for (uint32_t slot = count; slot < frames_in_flight; slot++)
+		{
+			WaitTimeline(graphics_timeline, _frames[slot]._timelineValue);
+			_frames[slot]._deletionQueue.flush();
+			_frames[slot]._frameDescriptors.clear_pools(engine->_device);
+		}
+	}
+	frames_in_flight = count;
+	return true;
+}
+
+float FFTRenderer::CascadePatchSize(uint32_t cascade) const
+{
+	return float(surface.grid_dimensions) / std::pow(CASCADE_SIZE_RATIO, float(cascade));
+}
+
+void FFTRenderer::SetSeed(uint64_t seed)
+{
+	sim_params.seed = seed;
+	sim_params.changed = true;
+}
+
+void FFTRenderer::SetSpectrumModel(SpectrumModel model, DirectionalSpreading spreading, bool tma_depth)
+{
+	sim_params.spectrum_model = model;
+	sim_params.spreading = spreading;
+	sim_params.tma_depth = tma_depth;
+	sim_params.changed = true;
+}
+
+OceanParams FFTRenderer::ReferenceParams() const
+{
+	OceanParams params;
+	params.resolution = int(surface.texture_dimensions);
+	params.patch_size = CascadePatchSize(0);
+	params.wind_speed = sim_params.wind_magnitude;
+	params.wind_angle = sim_params.wind_angle;
+	params.fetch = ocean_params.fetch;
+	params.swell = ocean_params.swell;
+	params.depth = ocean_params.depth;
+	params.displacement_factor = ocean_params.displacement_factor;
+	params.seed = sim_params.seed;
+	params.spectrum = OceanParams::Spectrum(sim_params.spectrum_model);
+	params.spreading = OceanParams::Spreading(sim_params.spreading);
+	params.tma_depth = sim_params.tma_depth;
+	params.half_precision_storage = half_precision;
+	return params;
+}
+
+VkFormat FFTRenderer::FieldFormat() const
+{
+	return half_precision ? VK_FORMAT_R16G16B16A16_SFLOAT : VK_FORMAT_R32G32B32A32_SFLOAT;
+}
+
+std::string FFTRenderer::FieldShaderPath(const char* name) const
+{
+	//Shaders touching the field images are also built with -DHALF_STORAGE into *_fp16.spv
+	return assets_path + "/shaders/" + name + (half_precision ? "_fp16.spv" : ".spv");
+}
+
+void FFTRenderer::SimulateAt(VkCommandBuffer cmd, double t)
+{
+	vkutil::transition_image(cmd, surface.ping_1.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+	vkutil::transition_image(cmd, surface.jacobian_XxZz_map.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+	vkutil::transition_image(cmd, surface.jacobian_xz_map.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+	vkutil::transition_image(cmd, surface.spectrum_fields.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+	vkutil::transition_image(cmd, surface.spatial_fields.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+
+	GenerateInitialSpectrum(cmd);
+
+	//PingPongPhasePass(cmd);
+	GenerateSpectrum(cmd, t);
+
+	//Perform FFT on every frequency field of every cascade at once, the caller wraps the result into the output maps
+	DoIFFT(cmd, &surface.spectrum_fields, &surface.spatial_fields, SPECTRUM_LAYER_COUNT * scheduled_cascades);
+}
+
+VkImageMemoryBarrier FFTRenderer::SpatialFieldsOwnership() const
+{
+	//Release on the compute queue and acquire on graphics use the same barrier
+	VkImageMemoryBarrier ownership = vkinit::image_barrier(surface.spatial_fields.image, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_ASPECT_COLOR_BIT);
+	ownership.srcQueueFamilyIndex = engine->_computeQueueFamily;
+	ownership.dstQueueFamilyIndex = engine->_graphicsQueueFamily;
+	return ownership;
+}
+
+void FFTRenderer::ReserveQueryBuffers(HeightQuerySlot& slot, size_t count)
+{
+	if (count <= slot.capacity)
+		return;
+
+	//Grow geometrically so repeated batches of similar size don't reallocate
+	size_t capacity = std::max<size_t>(slot.capacity * 2, std::max<size_t>(count, 64));
+	if (slot.capacity != 0)
+	{
+		resource_manager->DestroyBuffer(slot.points);
+		resource_manager->DestroyBuffer(slot.heights);
+	}
+	slot.points = resource_manager->CreateBuffer(capacity * sizeof(OceanPoint), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU, "height query points");
+	slot.heights = resource_manager->CreateBuffer(capacity * sizeof(float), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_GPU_TO_CPU, "height query results");
+	slot.capacity = capacity;
+}
+
+void FFTRenderer::InitHeightQueries()
+{
+	//Wrap and sampling always run on graphics, with async compute the simulation half goes to the compute family
+	VkCommandPoolCreateInfo commandPoolInfo = vkinit::command_pool_create_info(engine->_graphicsQueueFamily, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
+	VkCommandPoolCreateInfo computePoolInfo = vkinit::command_pool_create_info(engine->_computeQueueFamily, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
+
+	std::vector<DescriptorAllocatorGrowable::PoolSizeRatio> query_sizes = {
+		{ VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 4 },
+		{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4 },
+		{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1 },
+	};
+
+	for (uint32_t i = 0; i < MAX_HEIGHT_QUERY_SLOTS; i++) {
+		HeightQuerySlot& slot = height_queries[i];
+		VK_CHECK(vkCreateCommandPool(engine->_device, &commandPoolInfo, nullptr, &slot.command_pool));
+
+		VkCommandBufferAllocateInfo cmdAllocInfo = vkinit::command_buffer_allocate_info(slot.command_pool, 1);
+		VK_CHECK(vkAllocateCommandBuffers(engine->_device, &cmdAllocInfo, &slot.command_buffer));
+
+		VK_CHECK(vkCreateCommandPool(engine->_device, &computePoolInfo, nullptr, &slot.compute_command_pool));
+		VkCommandBufferAllocateInfo computeAllocInfo = vkinit::command_buffer_allocate_info(slot.compute_command_pool, 1);
+		VK_CHECK(vkAllocateCommandBuffers(engine->_device, &computeAllocInfo, &slot.compute_command_buffer));
+
+		slot.descriptors.init(engine->_device, 32, query_sizes);
+	}
+
+	_mainDeletionQueue.push_function([=]() {
+		for (uint32_t i = 0; i < MAX_HEIGHT_QUERY_SLOTS; i++) {
+			HeightQuerySlot& slot = height_queries[i];
+			vkDestroyCommandPool(engine->_device, slot.command_pool, nullptr);
+			vkDestroyCommandPool(engine->_device, slot.compute_command_pool, nullptr);
+			slot.descriptors.destroy_pools(engine->_device);
+			if (slot.capacity != 0)
+			{
+				resource_manager->DestroyBuffer(slot.points);
+				resource_manager->DestroyBuffer(slot.heights);
+			}
+		}
+		});
 }
 
 void FFTRenderer::Init(VulkanEngine* engine)
@@ -125,6 +466,11 @@ void FFTRenderer::Init(VulkanEngine* engine)
 
 	InitEngine();
 
+	//Without a family of its own the compute work would only interleave with the graphics queue's
+	async_compute = async_compute_requested && engine->_asyncComputeAvailable;
+	if (async_compute_requested && !async_compute)
+		std::cout << "No separate compute queue family, the simulation stays on the graphics queue" << std::endl;
+
 	ConfigureRenderWindow();
 
 	InitSwapchain();
@@ -137,6 +483,8 @@ void FFTRenderer::Init(VulkanEngine* engine)
 
 	InitDescriptors();
 
+	InitHeightQueries();
+
 	InitDefaultData();
 
 	//InitBuffers();
@@ -152,29 +500,106 @@ void FFTRenderer::Init(VulkanEngine* engine)
 	_isInitialized = true;
 }
 
-void FFTRenderer::PreProcessComputePass()
+void FFTRenderer::InitHeadless(VulkanEngine* engine)
 {
-	VkDescriptorSet butterFlyDescriptor = globalDescriptorAllocator.allocate(engine->_device, butterfly_layout);
+	assert(engine != nullptr);
+	this->engine = engine;
+	headless = true;
+
+	InitEngine();
+
+	InitCommands();
+
+	InitSyncStructures();
+
+	InitDescriptors();
+
+	InitHeightQueries();
+
+	InitDefaultData();
+
+	InitComputePipelines();
 
+	PreProcessComputePass();
+
+	_isInitialized = true;
+}
+
+void FFTRenderer::PreProcessComputePass()
+{
 	ocean_params.ocean_size = surface.grid_dimensions;
 	ocean_params.resolution = surface.texture_dimensions;
 	ocean_params.log_size = log2(surface.texture_dimensions);
+	ocean_params.cascade_count = int(cascade_count);
+	for (uint32_t cascade = 0; cascade < MAX_CASCADES; cascade++)
+	{
+		ocean_params.cascade_sizes[cascade] = CascadePatchSize(cascade);
+		ocean_scene_data.cascade_sizes[cascade] = ocean_params.cascade_sizes[cascade];
+	}
+	ocean_scene_data.cascade_count = int(cascade_count);
 
-	engine->immediate_submit([&](VkCommandBuffer cmd)
-		{
-			vkutil::transition_image(cmd, surface.butterfly_texture.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
-			DescriptorWriter writer;
-			writer.write_image(0, surface.butterfly_texture.imageView,defaultSamplerLinear,VK_IMAGE_LAYOUT_GENERAL, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
-			writer.update_set(engine->_device, butterFlyDescriptor);
-
-			
-			vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, butterfly_pso.pipeline);
-
-			vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, butterfly_pso.layout, 0, 1, &butterFlyDescriptor, 0, nullptr);
+	//Twiddles of every FFT pass are entries of exp(2 pi i m / N), computed once in double precision
+	const uint32_t N = surface.texture_dimensions;
+	std::vector<glm::vec2> twiddles(N);
+	for (uint32_t m = 0; m < N; m++)
+	{
+		double angle = 2.0 * M_PI * double(m) / double(N);
+		twiddles[m] = glm::vec2(float(std::cos(angle)), float(std::sin(angle)));
+	}
+	surface.twiddle_table = resource_manager->CreateAndUpload(N * sizeof(glm::vec2), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_ONLY, twiddles.data(), "twiddle table");
 
-			vkCmdPushConstants(cmd, butterfly_pso.layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(FFTParams), &ocean_params);
-			vkCmdDispatch(cmd, ocean_params.log_size, (surface.texture_dimensions / 8), 1);
+	//exp(i omega PHASE_STEP) of every mode, also in double precision so stepping only adds the rounding of the products.
+	//Same wave vector grid as WaveVector in time_dependent_spectrum.comp
+	std::vector<glm::vec2> phase_steps(size_t(N) * N * cascade_count);
+	for (uint32_t cascade = 0; cascade < cascade_count; cascade++)
+	{
+		const double patch_size = double(ocean_params.cascade_sizes[cascade]);
+		for (uint32_t y = 0; y < N; y++)
+		{
+			for (uint32_t x = 0; x < N; x++)
+			{
+				double kx = 2.0 * M_PI * (double(x) - 0.5 * N) / patch_size;
+				double ky = 2.0 * M_PI * (double(y) - 0.5 * N) / patch_size;
+				double k = (kx == 0.0 && ky == 0.0) ? std::hypot(0.0001, 0.0001) : std::hypot(kx, ky);
+				double angle = std::sqrt(9.81 * k) * PHASE_STEP;
+				phase_steps[(size_t(cascade) * N + y) * N + x] = glm::vec2(float(std::cos(angle)), float(std::sin(angle)));
+			}
+		}
+	}
+	surface.phasor_steps = resource_manager->CreateAndUpload(PhasorBytes(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_ONLY, phase_steps.data(), "phasor steps");
+	if (async_compute)
+	{
+		//Uploaded on the graphics queue but only read by the compute passes, ownership moves to the compute family once
+		VkBufferMemoryBarrier ownership[2];
+		AllocatedBuffer* uploads[2] = { &surface.twiddle_table, &surface.phasor_steps };
+		for (uint32_t i = 0; i < 2; i++)
+		{
+			ownership[i] = { VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER };
+			ownership[i].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			ownership[i].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+			ownership[i].srcQueueFamilyIndex = engine->_graphicsQueueFamily;
+			ownership[i].dstQueueFamilyIndex = engine->_computeQueueFamily;
+			ownership[i].buffer = uploads[i]->buffer;
+			ownership[i].size = VK_WHOLE_SIZE;
+		}
+		engine->immediate_submit([&](VkCommandBuffer cmd) {
+			vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 2, ownership, 0, nullptr);
+			});
+		engine->immediate_submit_compute([&](VkCommandBuffer cmd) {
+			vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 2, ownership, 0, nullptr);
 			});
+	}
+	//Filled by the first incremental dispatch, which always resets
+	surface.phasors = resource_manager->CreateBuffer(PhasorBytes(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_GPU_ONLY, "phasors");
+	for (CascadeState& cascade : cascades)
+		cascade.phase_valid = false;
+	cascade_history_valid = false;
+
+	_mainDeletionQueue.push_function([=]() {
+		resource_manager->DestroyBuffer(surface.twiddle_table);
+		resource_manager->DestroyBuffer(surface.phasors);
+		resource_manager->DestroyBuffer(surface.phasor_steps);
+		});
 }
 void FFTRenderer::ConfigureRenderWindow()
 {
@@ -232,6 +657,7 @@ void FFTRenderer::InitEngine()
 	features12.descriptorBindingUpdateUnusedWhilePending = true;
 	features12.descriptorBindingVariableDescriptorCount = true;
 	features12.samplerFilterMinmax = true;
+	features12.timelineSemaphore = true;
 
 
 	VkPhysicalDeviceVulkan11Features features11{};
@@ -244,7 +670,14 @@ void FFTRenderer::InitEngine()
 	baseFeatures.sampleRateShading = true;
 	baseFeatures.drawIndirectFirstInstance = true;
 	baseFeatures.multiDrawIndirect = true;
-	engine->init(baseFeatures, features11, features12, features);
+
+	if (headless)
+	{
+		//Nothing is rasterised, drop the draw features so compute only and software devices qualify
+		baseFeatures = VkPhysicalDeviceFeatures{};
+		features11.shaderDrawParameters = false;
+	}
+	engine->init(baseFeatures, features11, features12, features, headless);
 	resource_manager = std::make_shared<ResourceManager>(engine);
 }
 
@@ -318,7 +751,8 @@ void FFTRenderer::InitCommands()
 {
 	VkCommandPoolCreateInfo commandPoolInfo = vkinit::command_pool_create_info(engine->_graphicsQueueFamily, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
 
-	for (int i = 0; i < FRAME_OVERLAP; i++) {
+	//Every slot is set up, SetFramesInFlight only changes how many of them the frames rotate through
+	for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
 
 		VK_CHECK(vkCreateCommandPool(engine->_device, &commandPoolInfo, nullptr, &_frames[i]._commandPool));
 
@@ -329,6 +763,16 @@ void FFTRenderer::InitCommands()
 
 		resource_manager->deletionQueue.push_function([=]() { vkDestroyCommandPool(engine->_device, _frames[i]._commandPool, nullptr); });
 
+		//Async compute records the simulation in its own pool and the wrap pass in a second graphics buffer
+		VkCommandPoolCreateInfo computePoolInfo = vkinit::command_pool_create_info(engine->_computeQueueFamily, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
+		VK_CHECK(vkCreateCommandPool(engine->_device, &computePoolInfo, nullptr, &_frames[i]._computeCommandPool));
+
+		VkCommandBufferAllocateInfo computeAllocInfo = vkinit::command_buffer_allocate_info(_frames[i]._computeCommandPool, 1);
+		VK_CHECK(vkAllocateCommandBuffers(engine->_device, &computeAllocInfo, &_frames[i]._computeCommandBuffer));
+		VK_CHECK(vkAllocateCommandBuffers(engine->_device, &cmdAllocInfo, &_frames[i]._wrapCommandBuffer));
+
+		resource_manager->deletionQueue.push_function([=]() { vkDestroyCommandPool(engine->_device, _frames[i]._computeCommandPool, nullptr); });
+
 
 		resource_manager->deletionQueue.push_function([=]() {
 			//vkFreeCommandBuffers(engine->_device, _frames[i]._commandPool, 1, &_frames[i]._mainCommandBuffer);
@@ -341,10 +785,24 @@ void FFTRenderer::InitCommands()
 
 void FFTRenderer::InitSyncStructures()
 {
-	VkFenceCreateInfo fenceCreateInfo = vkinit::fence_create_info(VK_FENCE_CREATE_SIGNALED_BIT);
-	for (int i = 0; i < FRAME_OVERLAP; i++) {
+	//One timeline per queue replaces the per frame fences, frames, wrap passes and height queries all signal and wait on them
+	VkSemaphoreTypeCreateInfo timelineTypeInfo{ VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO };
+	timelineTypeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+	timelineTypeInfo.initialValue = 0;
+	VkSemaphoreCreateInfo timelineCreateInfo = vkinit::semaphore_create_info();
+	timelineCreateInfo.pNext = &timelineTypeInfo;
+
+	graphics_timeline.queue = engine->_graphicsQueue;
+	compute_timeline.queue = engine->_computeQueue;
+	VK_CHECK(vkCreateSemaphore(engine->_device, &timelineCreateInfo, nullptr, &graphics_timeline.semaphore));
+	VK_CHECK(vkCreateSemaphore(engine->_device, &timelineCreateInfo, nullptr, &compute_timeline.semaphore));
+
+	resource_manager->deletionQueue.push_function([=]() {
+		vkDestroySemaphore(engine->_device, graphics_timeline.semaphore, nullptr);
+		vkDestroySemaphore(engine->_device, compute_timeline.semaphore, nullptr);
+		});
 
-		VK_CHECK(vkCreateFence(engine->_device, &fenceCreateInfo, nullptr, &_frames[i]._renderFence));
+	for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
 
 		VkSemaphoreCreateInfo semaphoreCreateInfo = vkinit::semaphore_create_info();
 
@@ -352,13 +810,62 @@ void FFTRenderer::InitSyncStructures()
 		VK_CHECK(vkCreateSemaphore(engine->_device, &semaphoreCreateInfo, nullptr, &_frames[i]._renderSemaphore));
 
 		resource_manager->deletionQueue.push_function([=]() {
-			vkDestroyFence(engine->_device, _frames[i]._renderFence, nullptr);
 			vkDestroySemaphore(engine->_device, _frames[i]._swapchainSemaphore, nullptr);
 			vkDestroySemaphore(engine->_device, _frames[i]._renderSemaphore, nullptr);
 			});
 	}
 }
 
+uint64_t FFTRenderer::SubmitTimeline(QueueTimeline& timeline, VkCommandBuffer cmd, std::initializer_list<VkSemaphoreSubmitInfo> waits, const VkSemaphoreSubmitInfo* binary_signal)
+{
+	VkSemaphoreSubmitInfo signals[2];
+	signals[0] = vkinit::semaphore_submit_info(VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, timeline.semaphore);
+	signals[0].value = ++timeline.value;
+	uint32_t signal_count = 1;
+	if (binary_signal != nullptr)
+		signals[signal_count++] = *binary_signal;
+
+	VkCommandBufferSubmitInfo cmdinfo = vkinit::command_buffer_submit_info(cmd);
+	VkSubmitInfo2 submit = vkinit::submit_info(&cmdinfo, nullptr, nullptr);
+	submit.waitSemaphoreInfoCount = uint32_t(waits.size());
+	submit.pWaitSemaphoreInfos = waits.begin();
+	submit.signalSemaphoreInfoCount = signal_count;
+	submit.pSignalSemaphoreInfos = signals;
+
+	VK_CHECK(vkQueueSubmit2(timeline.queue, 1, &submit, VK_NULL_HANDLE));
+	return timeline.value;
+}
+
+void FFTRenderer::WaitTimeline(const QueueTimeline& timeline, uint64_t value)
+{
+	auto start_wait = std::chrono::steady_clock::now();
+
+	VkSemaphoreWaitInfo waitInfo{ VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO };
+	waitInfo.semaphoreCount = 1;
+	waitInfo.pSemaphores = &timeline.semaphore;
+	waitInfo.pValues = &value;
+	VK_CHECK(vkWaitSemaphores(engine->_device, &waitInfo, 9999999999));
+
+	auto elapsed_wait = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start_wait);
+	cpu_wait_ms += elapsed_wait.count() / 1000.f;
+
+	ReclaimRetiredSpectra();
+}
+
+void FFTRenderer::ReclaimRetiredSpectra()
+{
+	if (retired_spectra.empty())
+		return;
+
+	const QueueTimeline& simulation = async_compute ? compute_timeline : graphics_timeline;
+	uint64_t completed = 0;
+	VK_CHECK(vkGetSemaphoreCounterValue(engine->_device, simulation.semaphore, &completed));
+	auto done = std::partition(retired_spectra.begin(), retired_spectra.end(), [=](const RetiredSpectrum& retired) { return retired.timeline_value > completed; });
+	for (auto it = done; it != retired_spectra.end(); ++it)
+		resource_manager->DestroyImage(it->image);
+	retired_spectra.erase(done, retired_spectra.end());
+}
+
 void FFTRenderer::InitDescriptors()
 {
 	//create a descriptor pool that will hold 10 sets with 1 image each
@@ -385,24 +892,17 @@ void FFTRenderer::InitDescriptors()
 		builder.add_binding(0, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
 		builder.add_binding(1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
 		builder.add_binding(2, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
-		builder.add_binding(3, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
 		wrap_spectrum_layout = builder.build(engine->_device, VK_SHADER_STAGE_COMPUTE_BIT);
 	}
 	{
 		DescriptorLayoutBuilder builder;
+		//Binding 1 held the wave vector texture, k and omega are now computed in the shaders
 		builder.add_binding(0, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
-		butterfly_layout = builder.build(engine->_device, VK_SHADER_STAGE_COMPUTE_BIT);
-	}
-
-	{
-		DescriptorLayoutBuilder builder;
-		builder.add_binding(0, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
-		builder.add_binding(1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
 		builder.add_binding(2, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
 		builder.add_binding(3, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
 		builder.add_binding(4, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
-		builder.add_binding(5, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
-		builder.add_binding(6, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
+		builder.add_binding(5, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+		builder.add_binding(6, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
 		spectrum_layout = builder.build(engine->_device, VK_SHADER_STAGE_COMPUTE_BIT);
 	}
 
@@ -410,22 +910,15 @@ void FFTRenderer::InitDescriptors()
 		DescriptorLayoutBuilder builder;
 		builder.add_binding(0, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
 		builder.add_binding(1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
-		builder.add_binding(2, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
+		builder.add_binding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
 		fft_layout = builder.build(engine->_device, VK_SHADER_STAGE_COMPUTE_BIT);
 	}
 
-	{
-		DescriptorLayoutBuilder builder;
-		builder.add_binding(0, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
-		builder.add_binding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
-		height_copy_layout = builder.build(engine->_device, VK_SHADER_STAGE_COMPUTE_BIT);
-
-	}
-
 	{
 		DescriptorLayoutBuilder builder;
 		builder.add_binding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
 		builder.add_binding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+		builder.add_binding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
 		height_sample_layout = builder.build(engine->_device, VK_SHADER_STAGE_COMPUTE_BIT);
 	}
 
@@ -460,7 +953,6 @@ void FFTRenderer::InitDescriptors()
 	}
 
 	_mainDeletionQueue.push_function([&]() {
-		vkDestroyDescriptorSetLayout(engine->_device, butterfly_layout, nullptr);
 		vkDestroyDescriptorSetLayout(engine->_device, image_blit_layout, nullptr);
 		vkDestroyDescriptorSetLayout(engine->_device, spectrum_layout, nullptr);
 		vkDestroyDescriptorSetLayout(engine->_device, ocean_shading_layout, nullptr);
@@ -468,12 +960,11 @@ void FFTRenderer::InitDescriptors()
 		vkDestroyDescriptorSetLayout(engine->_device, resource_manager->bindless_descriptor_layout, nullptr);
 		vkDestroyDescriptorSetLayout(engine->_device, debug_layout, nullptr);
 		vkDestroyDescriptorSetLayout(engine->_device, height_sample_layout, nullptr);
-		vkDestroyDescriptorSetLayout(engine->_device, height_copy_layout, nullptr);
 		vkDestroyDescriptorSetLayout(engine->_device, fft_layout, nullptr);
 		vkDestroyDescriptorSetLayout(engine->_device, wrap_spectrum_layout, nullptr);
 		});
 
-	for (int i = 0; i < FRAME_OVERLAP; i++) {
+	for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
 		// create a descriptor 
 		std::vector<DescriptorAllocatorGrowable::PoolSizeRatio> frame_sizes = {
 			{ VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 3 },
@@ -561,7 +1052,7 @@ void FFTRenderer::DrawOceanMesh(VkCommandBuffer cmd)
 void FFTRenderer::BuildOceanMesh()
 {
 	float tex_coord_scale = 1.f;
-	int GRID_DIM = 512;
+	int GRID_DIM = int(surface.grid_dimensions);
 	int HALF_DIM = GRID_DIM / 2;
 	int vertex_count = GRID_DIM + 1;
 	int idx = 0;
@@ -690,8 +1181,9 @@ void FFTRenderer::InitComputePipelines()
 	VK_CHECK(vkCreatePipelineLayout(engine->_device, &spectrum_layout_info, nullptr, &spectrum_pso.layout));
 
 	VkShaderModule spectrum_shader;
-	if (!vkutil::load_shader_module(std::string(assets_path + "/shaders/time_dependent_spectrum.spv").c_str(), engine->_device, &spectrum_shader)) {
+	if (!vkutil::load_shader_module(FieldShaderPath("time_dependent_spectrum").c_str(), engine->_device, &spectrum_shader)) {
 		std::cout<<"Error when building the compute shader \n";
+		abort();
 	}
 	
 	auto spectrum_stage_info = vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_COMPUTE_BIT, spectrum_shader);
@@ -699,41 +1191,38 @@ void FFTRenderer::InitComputePipelines()
 	
 	VK_CHECK(vkCreateComputePipelines(engine->_device, VK_NULL_HANDLE, 1, &spectrum_compute_pipeline_creation_info, nullptr, &spectrum_pso.pipeline));
 
+	//Same shader stepping the stored phasors, picked by GenerateSpectrum for wall clock frames
+	VK_CHECK(vkCreatePipelineLayout(engine->_device, &spectrum_layout_info, nullptr, &incremental_spectrum_pso.layout));
 
-	auto copy_buffer_layout_info = vkinit::pipeline_layout_create_info();
-	copy_buffer_layout_info.pSetLayouts = &height_copy_layout;
-	copy_buffer_layout_info.setLayoutCount = 1;
+	VkBool32 incremental_phase_constant = VK_TRUE;
+	VkSpecializationMapEntry incremental_phase_entry{ 0, 0, sizeof(VkBool32) };
+	VkSpecializationInfo incremental_phase_info{ 1, &incremental_phase_entry, sizeof(VkBool32), &incremental_phase_constant };
+	auto incremental_spectrum_stage_info = vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_COMPUTE_BIT, spectrum_shader);
+	incremental_spectrum_stage_info.pSpecializationInfo = &incremental_phase_info;
+	auto incremental_spectrum_compute_pipeline_creation_info = vkinit::compute_pipeline_create_info(incremental_spectrum_pso.layout, incremental_spectrum_stage_info);
 
-	VkPushConstantRange buffer_push_constant{};
-	buffer_push_constant.offset = 0;
-	buffer_push_constant.size = sizeof(int);
-	buffer_push_constant.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	VK_CHECK(vkCreateComputePipelines(engine->_device, VK_NULL_HANDLE, 1, &incremental_spectrum_compute_pipeline_creation_info, nullptr, &incremental_spectrum_pso.pipeline));
 
-	copy_buffer_layout_info.pPushConstantRanges = &buffer_push_constant;
-	copy_buffer_layout_info.pushConstantRangeCount = 1;
 
-	VK_CHECK(vkCreatePipelineLayout(engine->_device, &copy_buffer_layout_info, nullptr, &copy_buffer_pso.layout));
+	//Batched height lookup
+	auto lookup_layout_info = vkinit::pipeline_layout_create_info();
+	lookup_layout_info.pSetLayouts = &height_sample_layout;
+	lookup_layout_info.setLayoutCount = 1;
 
-	VkShaderModule copy_buffer_shader;
-	if (!vkutil::load_shader_module(std::string(assets_path + "/shaders/copy_height_buffer.spv").c_str(), engine->_device, &copy_buffer_shader)) {
-		std::cout << "Error when building the compute shader \n";
-	}
+	VkPushConstantRange lookup_push_constant{};
+	lookup_push_constant.offset = 0;
+	lookup_push_constant.size = sizeof(HeightSampleParams);
+	lookup_push_constant.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
 
-	auto copy_buffer_stage_info = vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_COMPUTE_BIT, copy_buffer_shader);
-	auto copy_buffer_compute_pipeline_creation_info = vkinit::compute_pipeline_create_info(copy_buffer_pso.layout, copy_buffer_stage_info);
+	lookup_layout_info.pPushConstantRanges = &lookup_push_constant;
+	lookup_layout_info.pushConstantRangeCount = 1;
 
-	VK_CHECK(vkCreateComputePipelines(engine->_device, VK_NULL_HANDLE, 1, &copy_buffer_compute_pipeline_creation_info, nullptr, &copy_buffer_pso.pipeline));
-
-	copy_buffer_layout_info.pSetLayouts = &height_sample_layout;
-	buffer_push_constant.size = sizeof(glm::vec2);
-	copy_buffer_layout_info.pPushConstantRanges = &buffer_push_constant;
-	copy_buffer_layout_info.pushConstantRangeCount = 1;
-
-	VK_CHECK(vkCreatePipelineLayout(engine->_device, &copy_buffer_layout_info, nullptr, &lookup_value_pso.layout));
+	VK_CHECK(vkCreatePipelineLayout(engine->_device, &lookup_layout_info, nullptr, &lookup_value_pso.layout));
 
 	VkShaderModule lookup_shader;
 	if (!vkutil::load_shader_module(std::string(assets_path + "/shaders/get_value.spv").c_str(), engine->_device, &lookup_shader)) {
 		std::cout << "Error when building the compute shader \n";
+		abort();
 	}
 
 	auto lookup_stage_info = vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_COMPUTE_BIT, lookup_shader);
@@ -752,8 +1241,9 @@ void FFTRenderer::InitComputePipelines()
 	VK_CHECK(vkCreatePipelineLayout(engine->_device, &wrap_spectrum_layout_info, nullptr, &wrap_spectrum_pso.layout));
 
 	VkShaderModule wrap_spectrum_shader;
-	if (!vkutil::load_shader_module(std::string(assets_path + "/shaders/spectrum_wrapper.spv").c_str(), engine->_device, &wrap_spectrum_shader)) {
+	if (!vkutil::load_shader_module(FieldShaderPath("spectrum_wrapper").c_str(), engine->_device, &wrap_spectrum_shader)) {
 		std::cout<<("Error when building the compute shader \n");
+		abort();
 	}
 
 	auto wrap_spectrum_stage_info = vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_COMPUTE_BIT, wrap_spectrum_shader);
@@ -764,7 +1254,7 @@ void FFTRenderer::InitComputePipelines()
 
 	
 	
-	//Phase Pso setup
+	//Normal 
 	auto image_blit_layout_info = vkinit::pipeline_layout_create_info();
 	image_blit_layout_info.pSetLayouts = &image_blit_layout;
 	image_blit_layout_info.setLayoutCount = 1;
@@ -772,64 +1262,12 @@ void FFTRenderer::InitComputePipelines()
 	image_blit_layout_info.pPushConstantRanges = &push_constant;
 	image_blit_layout_info.pushConstantRangeCount = 1;
 
-	VK_CHECK(vkCreatePipelineLayout(engine->_device, &image_blit_layout_info, nullptr, &phase_pso.layout));
-
-	VkShaderModule phase_shader;
-	if (!vkutil::load_shader_module(std::string(assets_path + "/shaders/phase.spv").c_str(), engine->_device, &phase_shader)) {
-		std::cout<<("Error when building the compute shader \n");
-	}
-
-	auto phase_stage_info = vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_COMPUTE_BIT, phase_shader);
-	auto phase_compute_pipeline_creation_info = vkinit::compute_pipeline_create_info(phase_pso.layout, phase_stage_info);
-
-	VK_CHECK(vkCreateComputePipelines(engine->_device, VK_NULL_HANDLE, 1, &phase_compute_pipeline_creation_info, nullptr, &phase_pso.pipeline));
-
-	//Conjugate spectrum setup
-	VK_CHECK(vkCreatePipelineLayout(engine->_device, &image_blit_layout_info, nullptr, &conjugate_spectrum_pso.layout));
-
-	VkShaderModule conjugate_spectrum_shader;
-	if (!vkutil::load_shader_module(std::string(assets_path + "/shaders/conjugate_spectrum.spv").c_str(), engine->_device, &conjugate_spectrum_shader)) {
-		std::cout<<("Error when building the compute shader \n");
-	}
-
-	auto conjugate_spectrum_stage_info = vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_COMPUTE_BIT, conjugate_spectrum_shader);
-	auto conjugate_spectrum_compute_pipeline_creation_info = vkinit::compute_pipeline_create_info(conjugate_spectrum_pso.layout, conjugate_spectrum_stage_info);
-
-	VK_CHECK(vkCreateComputePipelines(engine->_device, VK_NULL_HANDLE, 1, &conjugate_spectrum_compute_pipeline_creation_info, nullptr, &conjugate_spectrum_pso.pipeline));
-
-	//Copy pass setup
-	VK_CHECK(vkCreatePipelineLayout(engine->_device, &image_blit_layout_info, nullptr, &copy_pso.layout));
-
-	VkShaderModule copy_shader;
-	if (!vkutil::load_shader_module(std::string(assets_path + "/shaders/copy.spv").c_str(), engine->_device, &copy_shader)) {
-		std::cout<<("Error when building the compute shader \n");
-	}
-
-	auto copy_stage_info = vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_COMPUTE_BIT, copy_shader);
-	auto copy_compute_pipeline_creation_info = vkinit::compute_pipeline_create_info(copy_pso.layout, copy_stage_info);
-
-	VK_CHECK(vkCreateComputePipelines(engine->_device, VK_NULL_HANDLE, 1, &copy_compute_pipeline_creation_info, nullptr, &copy_pso.pipeline));
-
-
-	//Permute scale pass setup
-	VK_CHECK(vkCreatePipelineLayout(engine->_device, &image_blit_layout_info, nullptr, &permute_scale_pso.layout));
-
-	VkShaderModule permute_shader;
-	if (!vkutil::load_shader_module(std::string(assets_path + "/shaders/permute_and_scale.spv").c_str(), engine->_device, &permute_shader)) {
-		std::cout<<("Error when building the compute shader \n");
-	}
-
-	auto permute_stage_info = vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_COMPUTE_BIT, permute_shader);
-	auto permute_compute_pipeline_creation_info = vkinit::compute_pipeline_create_info(permute_scale_pso.layout, permute_stage_info);
-
-	VK_CHECK(vkCreateComputePipelines(engine->_device, VK_NULL_HANDLE, 1, &permute_compute_pipeline_creation_info, nullptr, &permute_scale_pso.pipeline));
-
-	//Normal 
 	VK_CHECK(vkCreatePipelineLayout(engine->_device, &image_blit_layout_info, nullptr, &normal_calculation_pso.layout));
 
 	VkShaderModule normal_shader;
 	if (!vkutil::load_shader_module(std::string(assets_path + "/shaders/normal_map.spv").c_str(), engine->_device, &normal_shader)) {
 		std::cout<<("Error when building the compute shader \n");
+		abort();
 	}
 
 	auto normal_stage_info = vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_COMPUTE_BIT, normal_shader);
@@ -837,19 +1275,12 @@ void FFTRenderer::InitComputePipelines()
 
 	VK_CHECK(vkCreateComputePipelines(engine->_device, VK_NULL_HANDLE, 1, &normal_compute_pipeline_creation_info, nullptr, &normal_calculation_pso.pipeline));
 
-	//Initial spectrum
-	VK_CHECK(vkCreatePipelineLayout(engine->_device, &spectrum_layout_info, nullptr, &initial_spectrum_pso.layout));
-
-	VkShaderModule initial_spectrum_shader;
-	if (!vkutil::load_shader_module(std::string(assets_path + "/shaders/jonswap_spectrum.spv").c_str(), engine->_device, &initial_spectrum_shader)) {
+	//Initial spectrum, its pipelines are specialised per spectrum model on first use in InitialSpectrumPSO
+	if (!vkutil::load_shader_module(std::string(assets_path + "/shaders/initial_spectrum.spv").c_str(), engine->_device, &initial_spectrum_shader)) {
 		std::cout<<("Error when building the compute shader \n");
+		abort();
 	}
 
-	auto initial_spectrum_stage_info = vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_COMPUTE_BIT, initial_spectrum_shader);
-	auto initial_spectrum_compute_pipeline_creation_info = vkinit::compute_pipeline_create_info(initial_spectrum_pso.layout, initial_spectrum_stage_info);
-
-	VK_CHECK(vkCreateComputePipelines(engine->_device, VK_NULL_HANDLE, 1, &initial_spectrum_compute_pipeline_creation_info, nullptr, &initial_spectrum_pso.pipeline));
-
 
 	///Debug shader
 	auto debug_layout_info = vkinit::pipeline_layout_create_info();
@@ -865,6 +1296,7 @@ void FFTRenderer::InitComputePipelines()
 	VkShaderModule debug_shader;
 	if (!vkutil::load_shader_module(std::string(assets_path + "/shaders/debug.spv").c_str(), engine->_device, &debug_shader)) {
 		std::cout<<("Error when building the compute shader \n");
+		abort();
 	}
 
 	auto debug_stage_info = vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_COMPUTE_BIT, debug_shader);
@@ -885,8 +1317,9 @@ void FFTRenderer::InitComputePipelines()
 	VK_CHECK(vkCreatePipelineLayout(engine->_device, &fft_layout_info, nullptr, &fft_vertical_pso.layout));
 
 	VkShaderModule fft_vertical_shader;
-	if (!vkutil::load_shader_module(std::string(assets_path + "/shaders/fft_vertical.spv").c_str(), engine->_device, &fft_vertical_shader)) {
+	if (!vkutil::load_shader_module(FieldShaderPath("fft_vertical").c_str(), engine->_device, &fft_vertical_shader)) {
 		std::cout<<("Error when building the compute shader \n");
+		abort();
 	}
 
 	auto fft_vertical_stage_info = vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_COMPUTE_BIT, fft_vertical_shader);
@@ -899,8 +1332,9 @@ void FFTRenderer::InitComputePipelines()
 	VK_CHECK(vkCreatePipelineLayout(engine->_device, &fft_layout_info, nullptr, &fft_horizontal_pso.layout));
 
 	VkShaderModule fft_horizontal_shader;
-	if (!vkutil::load_shader_module(std::string(assets_path + "/shaders/fft_horizontal.spv").c_str(), engine->_device, &fft_horizontal_shader)) {
+	if (!vkutil::load_shader_module(FieldShaderPath("fft_horizontal").c_str(), engine->_device, &fft_horizontal_shader)) {
 		std::cout<<("Error when building the compute shader \n");
+		abort();
 	}
 
 	auto fft_horizontal_stage_info = vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_COMPUTE_BIT, fft_horizontal_shader);
@@ -909,56 +1343,123 @@ void FFTRenderer::InitComputePipelines()
 	VK_CHECK(vkCreateComputePipelines(engine->_device, VK_NULL_HANDLE, 1, &fft_horizontal_compute_pipeline_creation_info, nullptr, &fft_horizontal_pso.pipeline));
 
 
-	//Butterfly pass
-	auto butterfly_layout_info = vkinit::pipeline_layout_create_info();
-	butterfly_layout_info.pSetLayouts = &butterfly_layout;
-	butterfly_layout_info.setLayoutCount = 1;
+	//Devices that shuffle inside compute subgroups swap the short stride butterflies in registers
+	VkPhysicalDeviceSubgroupProperties subgroup_properties{};
+	subgroup_properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_PROPERTIES;
+	VkPhysicalDeviceProperties2 device_properties2{};
+	device_properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+	device_properties2.pNext = &subgroup_properties;
+	vkGetPhysicalDeviceProperties2(engine->_chosenGPU, &device_properties2);
+	subgroup_fft_supported = (subgroup_properties.supportedStages & VK_SHADER_STAGE_COMPUTE_BIT) &&
+		(subgroup_properties.supportedOperations & VK_SUBGROUP_FEATURE_SHUFFLE_BIT) &&
+		subgroup_properties.subgroupSize > 1;
+	subgroup_size = subgroup_properties.subgroupSize;
+
+	//Single dispatch FFT, one pipeline per axis from the same shader
+	VkShaderModule stockham_shader;
+	if (!vkutil::load_shader_module(FieldShaderPath(subgroup_fft_supported ? "fft_subgroup" : "fft_stockham").c_str(), engine->_device, &stockham_shader)) {
+		std::cout << "Error when building the compute shader \n";
+		abort();
+	}
 
-	butterfly_layout_info.pPushConstantRanges = &push_constant;
-	butterfly_layout_info.pushConstantRangeCount = 1;
+	//Large lines are split over at most 256 invocations, the shader loops over the remaining butterflies
+	FFTSpecialization horizontal_constants;
+	horizontal_constants.resolution = surface.texture_dimensions;
+	horizontal_constants.log_size = uint32_t(log2(surface.texture_dimensions));
+	horizontal_constants.line_threads = std::min(surface.texture_dimensions / 2, 256u);
+	FFTSpecialization vertical_constants = horizontal_constants;
+	vertical_constants.horizontal = VK_FALSE;
+
+	VkSpecializationMapEntry fft_constant_entries[] = {
+		{ 0, offsetof(FFTSpecialization, horizontal), sizeof(VkBool32) },
+		{ 1, offsetof(FFTSpecialization, resolution), sizeof(uint32_t) },
+		{ 2, offsetof(FFTSpecialization, log_size), sizeof(uint32_t) },
+		{ 3, offsetof(FFTSpecialization, line_threads), sizeof(uint32_t) },
+	};
+	VkSpecializationInfo direction_info{ 4, fft_constant_entries, sizeof(FFTSpecialization), &horizontal_constants };
 
+	VK_CHECK(vkCreatePipelineLayout(engine->_device, &fft_layout_info, nullptr, &stockham_horizontal_pso.layout));
 
-	//FFT Vertical
-	VK_CHECK(vkCreatePipelineLayout(engine->_device, &butterfly_layout_info, nullptr, &butterfly_pso.layout));
+	auto stockham_horizontal_stage_info = vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_COMPUTE_BIT, stockham_shader);
+	stockham_horizontal_stage_info.pSpecializationInfo = &direction_info;
+	auto stockham_horizontal_compute_pipeline_creation_info = vkinit::compute_pipeline_create_info(stockham_horizontal_pso.layout, stockham_horizontal_stage_info);
 
-	VkShaderModule butterfly_shader;
-	if (!vkutil::load_shader_module(std::string(assets_path + "/shaders/butterfly.spv").c_str(), engine->_device, &butterfly_shader)) {
-		std::cout<<"Error when building the compute shader \n";
-	}
+	VK_CHECK(vkCreateComputePipelines(engine->_device, VK_NULL_HANDLE, 1, &stockham_horizontal_compute_pipeline_creation_info, nullptr, &stockham_horizontal_pso.pipeline));
 
-	auto butterfly_stage_info = vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_COMPUTE_BIT, butterfly_shader);
-	auto butterfly_compute_pipeline_creation_info = vkinit::compute_pipeline_create_info(butterfly_pso.layout, butterfly_stage_info);
+	VkSpecializationInfo vertical_info{ 4, fft_constant_entries, sizeof(FFTSpecialization), &vertical_constants };
+
+	VK_CHECK(vkCreatePipelineLayout(engine->_device, &fft_layout_info, nullptr, &stockham_vertical_pso.layout));
+
+	auto stockham_vertical_stage_info = vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_COMPUTE_BIT, stockham_shader);
+	stockham_vertical_stage_info.pSpecializationInfo = &vertical_info;
+	auto stockham_vertical_compute_pipeline_creation_info = vkinit::compute_pipeline_create_info(stockham_vertical_pso.layout, stockham_vertical_stage_info);
+
+	VK_CHECK(vkCreateComputePipelines(engine->_device, VK_NULL_HANDLE, 1, &stockham_vertical_compute_pipeline_creation_info, nullptr, &stockham_vertical_pso.pipeline));
+
+	//A whole line of RGBA32F texels and a quarter of the twiddle table have to fit in shared memory, e.g. 4096 needs 72KB
+	VkPhysicalDeviceProperties device_properties;
+	vkGetPhysicalDeviceProperties(engine->_chosenGPU, &device_properties);
+	const uint32_t line_bytes = surface.texture_dimensions * 4 * sizeof(float) + surface.texture_dimensions / 4 * sizeof(glm::vec2);
+	const uint32_t line_threads = horizontal_constants.line_threads;
+	shared_fft_supported = device_properties.limits.maxComputeSharedMemorySize >= line_bytes &&
+		device_properties.limits.maxComputeWorkGroupSize[0] >= line_threads &&
+		device_properties.limits.maxComputeWorkGroupInvocations >= line_threads;
+	use_shared_memory_fft = shared_fft_supported;
+
+	//Small fields run rows, columns and the sign permutation in a single workgroup per layer.
+	//The grid holds one complex signal at a time, 32KB at 64 x 64
+	const uint32_t grid_threads = std::min(surface.texture_dimensions * surface.texture_dimensions / 4, 256u);
+	const uint32_t grid_bytes = surface.texture_dimensions * surface.texture_dimensions * 2 * sizeof(float);
+	single_workgroup_fft_supported = surface.texture_dimensions <= MAX_SINGLE_WORKGROUP_FFT_RESOLUTION &&
+		device_properties.limits.maxComputeSharedMemorySize >= grid_bytes &&
+		device_properties.limits.maxComputeWorkGroupSize[0] >= grid_threads &&
+		device_properties.limits.maxComputeWorkGroupInvocations >= grid_threads;
+
+	VkShaderModule fft_2d_shader = VK_NULL_HANDLE;
+	if (single_workgroup_fft_supported)
+	{
+		FFTSpecialization grid_constants = horizontal_constants;
+		grid_constants.line_threads = grid_threads;
+		VkSpecializationInfo grid_info{ 4, fft_constant_entries, sizeof(FFTSpecialization), &grid_constants };
+
+		VK_CHECK(vkCreatePipelineLayout(engine->_device, &fft_layout_info, nullptr, &fft_2d_pso.layout));
+
+		if (!vkutil::load_shader_module(FieldShaderPath("fft_2d").c_str(), engine->_device, &fft_2d_shader)) {
+			std::cout << "Error when building the compute shader \n";
+			abort();
+		}
+
+		auto fft_2d_stage_info = vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_COMPUTE_BIT, fft_2d_shader);
+		fft_2d_stage_info.pSpecializationInfo = &grid_info;
+		auto fft_2d_compute_pipeline_creation_info = vkinit::compute_pipeline_create_info(fft_2d_pso.layout, fft_2d_stage_info);
+
+		VK_CHECK(vkCreateComputePipelines(engine->_device, VK_NULL_HANDLE, 1, &fft_2d_compute_pipeline_creation_info, nullptr, &fft_2d_pso.pipeline));
+	}
 
-	VK_CHECK(vkCreateComputePipelines(engine->_device, VK_NULL_HANDLE, 1, &butterfly_compute_pipeline_creation_info, nullptr, &butterfly_pso.pipeline));
 
-	
 	_mainDeletionQueue.push_function([=]() {
 		resource_manager->DestroyPSO(spectrum_pso);
-		resource_manager->DestroyPSO(initial_spectrum_pso);
+		resource_manager->DestroyPSO(incremental_spectrum_pso);
+		for (auto& variant : initial_spectrum_psos)
+			resource_manager->DestroyPSO(variant.second);
+		initial_spectrum_psos.clear();
 		resource_manager->DestroyPSO(normal_calculation_pso);
 		resource_manager->DestroyPSO(fft_vertical_pso);
 		resource_manager->DestroyPSO(fft_horizontal_pso);
+		resource_manager->DestroyPSO(stockham_horizontal_pso);
+		resource_manager->DestroyPSO(stockham_vertical_pso);
+		resource_manager->DestroyPSO(fft_2d_pso);
 		resource_manager->DestroyPSO(debug_pso);
-		resource_manager->DestroyPSO(copy_pso);
-		resource_manager->DestroyPSO(phase_pso);
-		resource_manager->DestroyPSO(copy_buffer_pso);
-		resource_manager->DestroyPSO(butterfly_pso);
-		resource_manager->DestroyPSO(conjugate_spectrum_pso);
 		resource_manager->DestroyPSO(lookup_value_pso);
-		resource_manager->DestroyPSO(permute_scale_pso);
 		resource_manager->DestroyPSO(wrap_spectrum_pso);
 		vkDestroyShaderModule(engine->_device, spectrum_shader, nullptr);
-		vkDestroyShaderModule(engine->_device, butterfly_shader, nullptr);
-		vkDestroyShaderModule(engine->_device, phase_shader, nullptr);
-		vkDestroyShaderModule(engine->_device, conjugate_spectrum_shader, nullptr);
-		vkDestroyShaderModule(engine->_device, copy_buffer_shader, nullptr);
-		vkDestroyShaderModule(engine->_device, copy_shader, nullptr);
 		vkDestroyShaderModule(engine->_device, fft_horizontal_shader, nullptr);
 		vkDestroyShaderModule(engine->_device, fft_vertical_shader, nullptr);
+		vkDestroyShaderModule(engine->_device, stockham_shader, nullptr);
+		vkDestroyShaderModule(engine->_device, fft_2d_shader, nullptr);
 		vkDestroyShaderModule(engine->_device, debug_shader, nullptr);
 		vkDestroyShaderModule(engine->_device, initial_spectrum_shader, nullptr);
 		vkDestroyShaderModule(engine->_device, normal_shader, nullptr);
-		vkDestroyShaderModule(engine->_device, permute_shader, nullptr);
 		vkDestroyShaderModule(engine->_device, wrap_spectrum_shader, nullptr);
 		vkDestroyShaderModule(engine->_device, lookup_shader, nullptr);
 		});
@@ -975,67 +1476,38 @@ void FFTRenderer::InitDefaultData()
 	//Create FFT resource images
 	uint32_t RES = surface.texture_dimensions;
 
-	std::vector<float> ping_phase_array(RES * RES);
-	std::vector<float> gaussian_noise(RES * RES * 2);
-
-	//generate phase values
-	std::random_device dev;
-	std::mt19937 rng(dev());
-	std::uniform_real_distribution<> distFloat(0.f, 1.f);
-	std::uniform_real_distribution<> distGaus(-1.f, 1.f);
-
-	for (size_t i = 0; i < RES * RES; ++i)
-	{
-		ping_phase_array[i] = distFloat(rng) * 2.f * M_PI;
-		//ping_phase_array[i] = distFloat(rng);
-		/*if (i < 70000)
-		{ 
-			ping_phase_array[i] = 0.0f;
-		}
-		else 
-			ping_phase_array[i] = 1.0f;
-		*/
-	}
-	
-	for (size_t i = 0; i < RES * RES * 2; ++i)
-	{
-		gaussian_noise[i] = distGaus(rng);
-	}
-
-	auto log_size = log2(RES);
 	VkExtent3D oceanExtent;
 	oceanExtent.width = RES;
 	oceanExtent.height = RES;
 	oceanExtent.depth = 1;
 
-	VkExtent3D logExtent;
-	logExtent = oceanExtent;
-	logExtent.width = log_size;
+	//Everything the per frame passes write. Initial spectra are FP32 and allocated by the h0 cache
+	const VkFormat field_format = FieldFormat();
+	//Every cascade takes SPECTRUM_LAYER_COUNT layers of the IFFT arrays, and the output maps keep its last
+	//CASCADE_KEY_COUNT updates for the renderer to interpolate between
+	const int field_layers = int(SPECTRUM_LAYER_COUNT * cascade_count);
+	const int key_layers = int(CASCADE_KEY_COUNT * cascade_count);
 
 	//stbi_load(std::string(assets_path + "textures/back.png"))
-	surface.displacement_map = resource_manager->CreateImage(oceanExtent, VK_FORMAT_R32G32B32A32_SFLOAT, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT, false, "Displacement map");
-	surface.inital_spectrum_texture = resource_manager->CreateImage(oceanExtent, VK_FORMAT_R32G32_SFLOAT, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT, false, "initial spectrum");
-	surface.horizontal_map = resource_manager->CreateImage(oceanExtent, VK_FORMAT_R32G32B32A32_SFLOAT, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT, false, "horizontal map");
-	surface.wave_texture = resource_manager->CreateImage(oceanExtent, VK_FORMAT_R32G32B32A32_SFLOAT, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT, false, "wave texture");
-	surface.conjugated_spectrum_texture = resource_manager->CreateImage(oceanExtent, VK_FORMAT_R32G32B32A32_SFLOAT, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT, false, "conjugated spectrum");
-	surface.height_map = resource_manager->CreateImage(oceanExtent, VK_FORMAT_R32G32B32A32_SFLOAT, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT,false, "height map");
-	surface.butterfly_texture = resource_manager->CreateImage(logExtent, VK_FORMAT_R32G32B32A32_SFLOAT, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT,false, "butterfly texture");
-	surface.gaussian_noise_texture = resource_manager->CreateImage(gaussian_noise.data(), oceanExtent, VK_FORMAT_R32G32_SFLOAT, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT, 8);
-	surface.height_derivative = resource_manager->CreateImage(oceanExtent, VK_FORMAT_R32G32B32A32_SFLOAT, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT, false, "height derivative permute");
-	surface.ping_1 = resource_manager->CreateImage(oceanExtent, VK_FORMAT_R32G32B32A32_SFLOAT, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT, false, "ping_1");
+	surface.displacement_map = resource_manager->CreateImageEmpty(oceanExtent, field_format, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_IMAGE_VIEW_TYPE_2D_ARRAY, false, key_layers);
+	surface.height_derivative = resource_manager->CreateImageEmpty(oceanExtent, field_format, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT, VK_IMAGE_VIEW_TYPE_2D_ARRAY, false, key_layers);
+	//Height queries wrap into maps of their own, so a query at any time leaves the frames' updates and blend intact
+	surface.query_displacement_map = resource_manager->CreateImageEmpty(oceanExtent, field_format, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_IMAGE_VIEW_TYPE_2D_ARRAY, false, key_layers);
+	surface.query_height_derivative = resource_manager->CreateImageEmpty(oceanExtent, field_format, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT, VK_IMAGE_VIEW_TYPE_2D_ARRAY, false, key_layers);
+	//IFFT input, output and scratch hold one layer per field so every stage covers all of them in one dispatch
+	surface.spectrum_fields = resource_manager->CreateImageEmpty(oceanExtent, field_format, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT, VK_IMAGE_VIEW_TYPE_2D_ARRAY, false, field_layers);
+	surface.spatial_fields = resource_manager->CreateImageEmpty(oceanExtent, field_format, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT, VK_IMAGE_VIEW_TYPE_2D_ARRAY, false, field_layers);
+	surface.ping_1 = resource_manager->CreateImageEmpty(oceanExtent, field_format, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT, VK_IMAGE_VIEW_TYPE_2D_ARRAY, false, field_layers);
 	surface.normal_map = resource_manager->CreateImage(oceanExtent, VK_FORMAT_R32G32B32A32_SFLOAT, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT, false, "normal map");
-	surface.frequency_domain_texture = resource_manager->CreateImage(oceanExtent, VK_FORMAT_R32G32B32A32_SFLOAT, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT, false, "frequency texture");
-	surface.horizontal_displacement_map = resource_manager->CreateImage(oceanExtent, VK_FORMAT_R32G32B32A32_SFLOAT, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT, false, "horizontal displacement");
-	surface.height_derivative_texture = resource_manager->CreateImage(oceanExtent, VK_FORMAT_R32G32B32A32_SFLOAT, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT, false, "height derivative");
-	surface.jacobian_XxZz_map = resource_manager->CreateImage(oceanExtent, VK_FORMAT_R32G32B32A32_SFLOAT, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT, false, "jacobian XxzZ");
-	surface.jacobian_xz_map = resource_manager->CreateImage(oceanExtent, VK_FORMAT_R32G32_SFLOAT, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT, false, "jacobian xz");
-	std::string cubemap_path(assets_path + "/textures/");
-	surface.sky_image = vkutil::load_cubemap_image(cubemap_path,engine, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT |VK_IMAGE_USAGE_SAMPLED_BIT,true );
+	surface.jacobian_XxZz_map = resource_manager->CreateImageEmpty(oceanExtent, VK_FORMAT_R32G32B32A32_SFLOAT, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT, VK_IMAGE_VIEW_TYPE_2D_ARRAY, false, int(cascade_count));
+	surface.jacobian_xz_map = resource_manager->CreateImageEmpty(oceanExtent, VK_FORMAT_R32G32_SFLOAT, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT, VK_IMAGE_VIEW_TYPE_2D_ARRAY, false, int(cascade_count));
+	if (!headless)
+	{
+		std::string cubemap_path(assets_path + "/textures/");
+		surface.sky_image = vkutil::load_cubemap_image(cubemap_path,engine, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT |VK_IMAGE_USAGE_SAMPLED_BIT,true );
+	}
 	ocean_params.log_size = log2(RES);
 	//Create default images
-	size_t height_buffer_size = RES * RES * sizeof(float);
-	surface.height_buffer = resource_manager->CreateBuffer(height_buffer_size,VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,VMA_MEMORY_USAGE_GPU_TO_CPU, "height buffer");
-	surface.sampled_value = resource_manager->CreateBuffer(sizeof(float), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_GPU_TO_CPU, "sampled buffer");
 	uint32_t black = glm::packUnorm4x8(glm::vec4(0, 0, 0, 0));
 	
 
@@ -1090,26 +1562,25 @@ void FFTRenderer::InitDefaultData()
 	//< default_img
 	
 	_mainDeletionQueue.push_function([=]() {
-		resource_manager->DestroyImage(surface.inital_spectrum_texture);
-		resource_manager->DestroyImage(surface.conjugated_spectrum_texture);
-		resource_manager->DestroyImage(surface.height_map);
+		for (CachedSpectrum& cached : spectrum_cache)
+			resource_manager->DestroyImage(cached.image);
+		spectrum_cache.clear();
+		for (RetiredSpectrum& retired : retired_spectra)
+			resource_manager->DestroyImage(retired.image);
+		retired_spectra.clear();
 		resource_manager->DestroyImage(surface.displacement_map);
-		resource_manager->DestroyImage(surface.horizontal_displacement_map);
-		resource_manager->DestroyImage(surface.horizontal_map);
-		resource_manager->DestroyImage(surface.wave_texture);
-		resource_manager->DestroyImage(surface.gaussian_noise_texture);
-		resource_manager->DestroyImage(surface.butterfly_texture);
 		resource_manager->DestroyImage(surface.height_derivative);
+		resource_manager->DestroyImage(surface.query_displacement_map);
+		resource_manager->DestroyImage(surface.query_height_derivative);
 		resource_manager->DestroyImage(surface.ping_1);
 		resource_manager->DestroyImage(surface.normal_map);
-		resource_manager->DestroyImage(surface.frequency_domain_texture);
+		resource_manager->DestroyImage(surface.spectrum_fields);
+		resource_manager->DestroyImage(surface.spatial_fields);
 		resource_manager->DestroyImage(surface.jacobian_XxZz_map);
 		resource_manager->DestroyImage(surface.jacobian_xz_map);
-		resource_manager->DestroyImage(surface.height_derivative_texture);
 		resource_manager->DestroyImage(storage_image);
-		resource_manager->DestroyImage(surface.sky_image);
-		resource_manager->DestroyBuffer(surface.height_buffer);
-		resource_manager->DestroyBuffer(surface.sampled_value);
+		if (!headless)
+			resource_manager->DestroyImage(surface.sky_image);
 		vkDestroySampler(engine->_device, defaultSamplerLinear, nullptr);
 		vkDestroySampler(engine->_device, defaultSamplerNearest, nullptr);
 		vkDestroySampler(engine->_device, cubeMapSampler, nullptr);
@@ -1284,23 +1755,98 @@ void FFTRenderer::Cleanup()
 		}
 		_mainDeletionQueue.flush();
 		resource_manager->cleanup();
-		DestroySwapchain();
+		if (!headless)
+			DestroySwapchain();
 		engine->cleanup();
 	}
 	engine = nullptr;
 }
 
-void FFTRenderer::GenerateInitialSpectrum(VkCommandBuffer cmd)
+VkDeviceSize FFTRenderer::SpectrumBytes() const
 {
-	//Generate intial spectrum
-	VkDescriptorSet initial_spectrum_set = get_current_frame()._frameDescriptors.allocate(engine->_device, spectrum_layout);
-	DescriptorWriter writer;
-	writer.write_image(0, surface.inital_spectrum_texture.imageView, samplerLinear, VK_IMAGE_LAYOUT_GENERAL, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
-	writer.write_image(1, surface.wave_texture.imageView, samplerLinear, VK_IMAGE_LAYOUT_GENERAL, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
-	writer.write_image(2, surface.gaussian_noise_texture.imageView, samplerLinear, VK_IMAGE_LAYOUT_GENERAL, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
+	return VkDeviceSize(surface.texture_dimensions) * surface.texture_dimensions * cascade_count * sizeof(glm::vec2);
+}
 
-	writer.update_set(engine->_device, initial_spectrum_set);
+VkDeviceSize FFTRenderer::PhasorBytes() const
+{
+	//One complex value per mode, same count as an initial spectrum
+	return SpectrumBytes();
+}
+
+bool FFTRenderer::UseCachedSpectrum(const SeaStateKey& key)
+{
+	for (auto it = spectrum_cache.begin(); it != spectrum_cache.end(); ++it)
+	{
+		if (it->key == key)
+		{
+			//A recent sea state only swaps the image the spectrum descriptors point at
+			spectrum_cache.splice(spectrum_cache.begin(), spectrum_cache, it);
+			surface.inital_spectrum_texture = spectrum_cache.front().image;
+			return true;
+		}
+	}
+	return false;
+}
+
+AllocatedImage FFTRenderer::AllocateCachedSpectrum(VkCommandBuffer cmd, const SeaStateKey& key)
+{
+	while (!spectrum_cache.empty() && VkDeviceSize(spectrum_cache.size() + 1) * SpectrumBytes() > spectrum_cache_budget)
+	{
+		//Spectrum passes submitted so far may still read it, it goes once the queue running them gets past them.
+		//The frame deletion queues would never run in headless mode
+		const QueueTimeline& simulation = async_compute ? compute_timeline : graphics_timeline;
+		retired_spectra.push_back({ spectrum_cache.back().image, simulation.value });
+		spectrum_cache.pop_back();
+	}
 
+	VkExtent3D extent{ surface.texture_dimensions, surface.texture_dimensions, 1 };
+	AllocatedImage image = resource_manager->CreateImageEmpty(extent, VK_FORMAT_R32G32_SFLOAT, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT, VK_IMAGE_VIEW_TYPE_2D_ARRAY, false, int(cascade_count));
+	//Cached spectra stay in GENERAL for good, later frames must not discard them with an UNDEFINED transition
+	vkutil::transition_image(cmd, image.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+	spectrum_cache.push_front({ key, image });
+	return image;
+}
+
+const PipelineStateObject& FFTRenderer::InitialSpectrumPSO(const SpectrumSpecialization& specialization)
+{
+	uint32_t variant = uint32_t(specialization.model) << 2 | uint32_t(specialization.spreading) << 1 | specialization.tma_depth;
+	auto cached = initial_spectrum_psos.find(variant);
+	if (cached != initial_spectrum_psos.end())
+		return cached->second;
+
+	auto spectrum_layout_info = vkinit::pipeline_layout_create_info();
+	spectrum_layout_info.pSetLayouts = &spectrum_layout;
+	spectrum_layout_info.setLayoutCount = 1;
+
+	VkPushConstantRange push_constant{};
+	push_constant.offset = 0;
+	push_constant.size = sizeof(FFTParams);
+	push_constant.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	spectrum_layout_info.pPushConstantRanges = &push_constant;
+	spectrum_layout_info.pushConstantRangeCount = 1;
+
+	PipelineStateObject pso;
+	VK_CHECK(vkCreatePipelineLayout(engine->_device, &spectrum_layout_info, nullptr, &pso.layout));
+
+	VkSpecializationMapEntry spectrum_constant_entries[] = {
+		{ 0, offsetof(SpectrumSpecialization, model), sizeof(uint32_t) },
+		{ 1, offsetof(SpectrumSpecialization, spreading), sizeof(uint32_t) },
+		{ 2, offsetof(SpectrumSpecialization, tma_depth), sizeof(VkBool32) },
+	};
+	VkSpecializationInfo spectrum_info{ 3, spectrum_constant_entries, sizeof(SpectrumSpecialization), &specialization };
+
+	auto initial_spectrum_stage_info = vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_COMPUTE_BIT, initial_spectrum_shader);
+	initial_spectrum_stage_info.pSpecializationInfo = &spectrum_info;
+	auto initial_spectrum_compute_pipeline_creation_info = vkinit::compute_pipeline_create_info(pso.layout, initial_spectrum_stage_info);
+
+	VK_CHECK(vkCreateComputePipelines(engine->_device, VK_NULL_HANDLE, 1, &initial_spectrum_compute_pipeline_creation_info, nullptr, &pso.pipeline));
+
+	return initial_spectrum_psos.emplace(variant, pso).first->second;
+}
+
+void FFTRenderer::UpdateSeaState()
+{
 	ocean_params.ocean_size = surface.grid_dimensions;
 	ocean_params.resolution = surface.texture_dimensions;
 	float wind_angle_rad = glm::radians(sim_params.wind_angle);
@@ -1308,82 +1854,274 @@ void FFTRenderer::GenerateInitialSpectrum(VkCommandBuffer cmd)
 	ocean_params.depth = 500.0f;
 	ocean_params.swell = 0.5f;
 	ocean_params.fetch = 1000.0f * 1000.0f;
+	ocean_params.seed_low = uint32_t(sim_params.seed);
+	ocean_params.seed_high = uint32_t(sim_params.seed >> 32);
+
+	SeaStateKey key{ sim_params.wind_magnitude, sim_params.wind_angle, ocean_params.fetch, ocean_params.depth, ocean_params.swell, sim_params.seed, surface.texture_dimensions,
+		sim_params.spectrum_model, sim_params.spreading, sim_params.tma_depth };
+	sim_params.changed = false;
+	//Updates of the previous sea state must not be blended into the new one
+	if (!(key == active_sea_state))
+	{
+		active_sea_state = key;
+		cascade_history_valid = false;
+		initial_spectrum_dirty = true;
+		first_check = true;
+	}
+}
+
+void FFTRenderer::GenerateInitialSpectrum(VkCommandBuffer cmd)
+{
+	initial_spectrum_dirty = false;
+	if (UseCachedSpectrum(active_sea_state))
+		return;
+	surface.inital_spectrum_texture = AllocateCachedSpectrum(cmd, active_sea_state);
+
+	//Generate intial spectrum
+	VkDescriptorSet initial_spectrum_set = compute_descriptors().allocate(engine->_device, spectrum_layout);
+	DescriptorWriter writer;
+	writer.write_image(0, surface.inital_spectrum_texture.imageView, samplerLinear, VK_IMAGE_LAYOUT_GENERAL, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
+
+	writer.update_set(engine->_device, initial_spectrum_set);
 
+	const PipelineStateObject& initial_spectrum_pso = InitialSpectrumPSO({ sim_params.spectrum_model, sim_params.spreading, sim_params.tma_depth ? VK_TRUE : VK_FALSE });
 	vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, initial_spectrum_pso.pipeline);
 
 	vkCmdPushConstants(cmd, initial_spectrum_pso.layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(FFTParams), &ocean_params);
 
 	vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, initial_spectrum_pso.layout, 0, 1, &initial_spectrum_set, 0, nullptr);
 
-	vkCmdDispatch(cmd, (surface.texture_dimensions / 32), (surface.texture_dimensions / 32) , 1);
+	vkCmdDispatch(cmd, (surface.texture_dimensions / 32), (surface.texture_dimensions / 32), cascade_count);
 
 	auto barrier = vkinit::image_barrier(surface.inital_spectrum_texture.image, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_ASPECT_COLOR_BIT);
 	image_barriers.push_back(barrier);
 
 	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_DEPENDENCY_BY_REGION_BIT, 0, 0, 0, 0, 1, &barrier);
+}
+
+void FFTRenderer::SetAbsoluteTime(double time)
+{
+	ocean_params.time_high = float(time);
+	ocean_params.time_low = float(time - double(ocean_params.time_high));
+}
 
-	//Conjugate generated spectrum
-	VkDescriptorSet conjugate_spectrum_set = get_current_frame()._frameDescriptors.allocate(engine->_device, image_blit_layout);
-	DescriptorWriter writer_c;
-	writer_c.write_image(0, surface.inital_spectrum_texture.imageView, samplerLinear, VK_IMAGE_LAYOUT_GENERAL, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
-	writer_c.write_image(1, surface.conjugated_spectrum_texture.imageView, samplerLinear, VK_IMAGE_LAYOUT_GENERAL, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
-	writer_c.update_set(engine->_device, conjugate_spectrum_set);
+void FFTRenderer::AdvancePhase(CascadeState& cascade, double time)
+{
+	ocean_params.step_count = 0;
+	ocean_params.phase_flags = 0;
+
+	//A cascade updated every period steps takes that many steps' worth at once
+	double steps = std::floor((time - cascade.phase_time) / PHASE_STEP);
+	if (!cascade.phase_valid || steps < 0.0 || steps > double(MAX_PHASE_STEPS_PER_FRAME * cascade.period))
+	{
+		//First frame, a long stall or time going backwards: evaluate exp(i omega t) once and step from there
+		cascade.phase_valid = true;
+		cascade.phase_time = time;
+		cascade.phase_steps_taken = 0;
+		ocean_params.phase_flags = PHASE_RESET;
+	}
+	else
+	{
+		uint64_t step_count = uint64_t(steps);
+		cascade.phase_time += double(step_count) * PHASE_STEP;
+		cascade.phase_steps_taken += step_count;
+		//Each product rounds a little and the error only grows, so the phasors go back to the absolute phase
+		//of phase_time, held in double on the host, before it can add up
+		if (cascade.phase_steps_taken >= PHASE_REANCHOR_INTERVAL)
+		{
+			cascade.phase_steps_taken = 0;
+			ocean_params.phase_flags = PHASE_RESET;
+		}
+		else
+			ocean_params.step_count = int(step_count);
+	}
+	SetAbsoluteTime(cascade.phase_time);
+}
 
-	vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, conjugate_spectrum_pso.pipeline);
+void FFTRenderer::BalanceCascadeOffsets()
+{
+	//Shortest periods first, each cascade then takes the phase whose frames carry the least work so far
+	uint32_t order[MAX_CASCADES];
+	std::iota(order, order + cascade_count, 0u);
+	std::stable_sort(order, order + cascade_count, [&](uint32_t a, uint32_t b) { return cascades[a].period < cascades[b].period; });
 
-	vkCmdPushConstants(cmd, conjugate_spectrum_pso.layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(FFTParams), &ocean_params);
+	uint32_t load[MAX_CASCADE_PERIOD] = {};
+	for (uint32_t i = 0; i < cascade_count; i++)
+	{
+		CascadeState& cascade = cascades[order[i]];
+		uint32_t best_peak = UINT32_MAX;
+		for (uint32_t offset = 0; offset < cascade.period; offset++)
+		{
+			uint32_t peak = 0;
+			for (uint32_t frame = 0; frame < MAX_CASCADE_PERIOD; frame++)
+				if ((frame + offset) % cascade.period == 0)
+					peak = std::max(peak, load[frame]);
+			if (peak < best_peak)
+			{
+				best_peak = peak;
+				cascade.offset = offset;
+			}
+		}
+		for (uint32_t frame = 0; frame < MAX_CASCADE_PERIOD; frame++)
+			if ((frame + cascade.offset) % cascade.period == 0)
+				load[frame]++;
+	}
+	cascade_offsets_dirty = false;
+}
 
-	vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, conjugate_spectrum_pso.layout, 0, 1, &conjugate_spectrum_set, 0, nullptr);
+void FFTRenderer::ScheduleCascades(double now)
+{
+	if (last_schedule_time >= 0.0 && now > last_schedule_time)
+		frame_interval += (std::min(now - last_schedule_time, 0.25) - frame_interval) * 0.1;
+	last_schedule_time = now;
+	if (cascade_offsets_dirty)
+		BalanceCascadeOffsets();
+
+	//In fixed rate mode the schedule counts steps of 1 / simulation_rate and a frame may fall between two of them
+	const bool fixed_rate = simulation_rate > 0.0f;
+	const uint64_t step = fixed_rate ? uint64_t(std::floor(now * double(simulation_rate))) : simulation_frame;
+
+	cascade_runs.clear();
+	scheduled_cascades = 0;
+	for (uint32_t c = 0; c < cascade_count; c++)
+	{
+		CascadeState& cascade = cascades[c];
+		//Update intervals of a cascade span period steps, it is due once the schedule enters a new one
+		const uint64_t interval = (step + cascade.offset) / cascade.period;
+		bool due = !cascade_history_valid;
+		if (!due)
+			due = fixed_rate ? interval != (last_simulation_step + cascade.offset) / cascade.period : (step + cascade.offset) % cascade.period == 0;
+		if (!due)
+			continue;
 
-	vkCmdDispatch(cmd, (surface.texture_dimensions / 32), (surface.texture_dimensions / 32), 1);
+		//Simulated for the end of its interval, so the frames in between only interpolate. A fixed rate puts the
+		//updates on the step grid, which keeps their spacing even however the frames fall
+		double key_time = now;
+		if (cascade_history_valid && fixed_rate)
+			key_time = double((interval + 1) * cascade.period - cascade.offset) / double(simulation_rate);
+		else if (cascade_history_valid)
+			key_time = now + double(cascade.period - 1) * frame_interval;
+		if (incremental_phase)
+		{
+			AdvancePhase(cascade, key_time);
+			key_time = cascade.phase_time;
+		}
+		else
+		{
+			ocean_params.step_count = 0;
+			ocean_params.phase_flags = 0;
+			SetAbsoluteTime(key_time);
+		}
+		cascade.previous_key_time = cascade_history_valid ? cascade.key_time : key_time;
+		cascade.key_time = key_time;
+		cascade.newest_key ^= 1;
 
+		ocean_params.cascade_base = int(c);
+		ocean_params.slot_base = int(scheduled_cascades);
+		ocean_params.key_layer = int(cascade.newest_key);
+		scheduled_cascades++;
 
+		//Neighbours due on the same frame share a dispatch when their phase parameters match
+		if (!cascade_runs.empty())
+		{
+			CascadeRun& run = cascade_runs.back();
+			if (run.first_cascade + run.count == c && run.key_layer == cascade.newest_key && run.params.time_high == ocean_params.time_high &&
+				run.params.time_low == ocean_params.time_low && run.params.step_count == ocean_params.step_count && run.params.phase_flags == ocean_params.phase_flags)
+			{
+				run.count++;
+				continue;
+			}
+		}
+		cascade_runs.push_back({ c, uint32_t(ocean_params.slot_base), 1, cascade.newest_key, ocean_params });
+	}
+	cascade_history_valid = true;
+	simulation_frame++;
+	last_simulation_step = step;
+
+	//Measured over about a second of wall clock, in fixed rate mode it should settle at simulation_rate
+	if (scheduled_cascades != 0)
+		simulated_steps++;
+	if (now - simulated_steps_start >= 1.0)
+	{
+		simulated_steps_per_second = float(double(simulated_steps) / (now - simulated_steps_start));
+		simulated_steps = 0;
+		simulated_steps_start = now;
+	}
 
+	for (uint32_t c = 0; c < cascade_count; c++)
+	{
+		const CascadeState& cascade = cascades[c];
+		double span = cascade.key_time - cascade.previous_key_time;
+		double blend = span > 0.0 ? (now - cascade.previous_key_time) / span : 1.0;
+		ocean_scene_data.cascade_blend[c] = float(std::clamp(blend, 0.0, 1.0));
+		ocean_scene_data.cascade_newest_key[c] = int(cascade.newest_key);
+	}
 }
 
-void FFTRenderer::GenerateSpectrum(VkCommandBuffer cmd, float time)
+void FFTRenderer::GenerateSpectrum(VkCommandBuffer cmd, double time)
 {
-	float currentFrame = glfwGetTime();
+	//Wall clock frames were scheduled by ScheduleFrame before recording started
+	double currentFrame = last_schedule_time;
 	float deltaTime = currentFrame - delta.lastFrame;
 	delta.lastFrame = currentFrame;
 	ocean_params.ocean_size = surface.grid_dimensions;
 	ocean_params.resolution = surface.texture_dimensions;
-	ocean_params.delta_time = time == -1.0 ? currentFrame : time;
+	ocean_params.delta_time = time < 0.0 ? currentFrame : time;
+
+	//Random access times, e.g. height queries, never touch the phasor state
+	bool incremental = incremental_phase && time < 0.0;
+	if (time < 0.0)
+	{
+		//A frame between two fixed rate steps, the renderer interpolates the maps as they are
+		if (cascade_runs.empty())
+			return;
+	}
+	else
+	{
+		//Every cascade at the requested time, over the first update layer of the query maps. The cascade schedule is left as it is
+		SetAbsoluteTime(time);
+		ocean_params.cascade_base = 0;
+		ocean_params.slot_base = 0;
+		ocean_params.key_layer = 0;
+		scheduled_cascades = cascade_count;
+		cascade_runs.assign(1, CascadeRun{ 0, 0, cascade_count, 0, ocean_params });
+	}
+	const PipelineStateObject& pso = incremental ? incremental_spectrum_pso : spectrum_pso;
 
-	VkDescriptorSet spectrum_set = get_current_frame()._frameDescriptors.allocate(engine->_device, spectrum_layout);
+	VkDescriptorSet spectrum_set = compute_descriptors().allocate(engine->_device, spectrum_layout);
 	DescriptorWriter writer;
 	
-	writer.write_image(0, surface.conjugated_spectrum_texture.imageView, samplerLinear, VK_IMAGE_LAYOUT_GENERAL, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
-	writer.write_image(1, surface.wave_texture.imageView, samplerLinear, VK_IMAGE_LAYOUT_GENERAL, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
-	writer.write_image(2, surface.frequency_domain_texture.imageView, samplerLinear, VK_IMAGE_LAYOUT_GENERAL, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
-	writer.write_image(3, surface.height_derivative_texture.imageView, samplerLinear, VK_IMAGE_LAYOUT_GENERAL, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
-	writer.write_image(4, surface.horizontal_displacement_map.imageView, samplerLinear, VK_IMAGE_LAYOUT_GENERAL, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
-	writer.write_image(5, surface.jacobian_XxZz_map.imageView, samplerLinear, VK_IMAGE_LAYOUT_GENERAL, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
-	writer.write_image(6, surface.jacobian_xz_map.imageView, samplerLinear, VK_IMAGE_LAYOUT_GENERAL, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
+	writer.write_image(0, surface.inital_spectrum_texture.imageView, samplerLinear, VK_IMAGE_LAYOUT_GENERAL, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
+	writer.write_image(2, surface.spectrum_fields.imageView, samplerLinear, VK_IMAGE_LAYOUT_GENERAL, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
+	writer.write_image(3, surface.jacobian_XxZz_map.imageView, samplerLinear, VK_IMAGE_LAYOUT_GENERAL, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
+	writer.write_image(4, surface.jacobian_xz_map.imageView, samplerLinear, VK_IMAGE_LAYOUT_GENERAL, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
+	writer.write_buffer(5, surface.phasors.buffer, PhasorBytes(), 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+	writer.write_buffer(6, surface.phasor_steps.buffer, PhasorBytes(), 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
 
 	writer.update_set(engine->_device, spectrum_set);
 
-	vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, spectrum_pso.pipeline);
+	vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, pso.pipeline);
 
-	vkCmdPushConstants(cmd, spectrum_pso.layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(FFTParams), &ocean_params);
+	vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, pso.layout, 0, 1, &spectrum_set, 0, nullptr);
 
-	vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, spectrum_pso.layout, 0, 1, &spectrum_set, 0, nullptr);
+	//Runs write disjoint slots and phasors, no barrier between them
+	for (const CascadeRun& run : cascade_runs)
+	{
+		vkCmdPushConstants(cmd, pso.layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(FFTParams), &run.params);
+		vkCmdDispatch(cmd, (surface.texture_dimensions / 32), (surface.texture_dimensions / 32), run.count);
+	}
 
-	vkCmdDispatch(cmd, (surface.texture_dimensions / 32), (surface.texture_dimensions / 32), 1);
+	//The global barrier also orders the phasor writes before the next frame advances them
+	VkMemoryBarrier phasor_barrier{ VK_STRUCTURE_TYPE_MEMORY_BARRIER, nullptr, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT };
+	auto barrier = vkinit::image_barrier(surface.spectrum_fields.image, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_ASPECT_COLOR_BIT);
+	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_DEPENDENCY_BY_REGION_BIT, 1, &phasor_barrier, 0, 0, 1, &barrier);
 }
 
 void FFTRenderer::DebugComputePass(VkCommandBuffer cmd)
 {
 	vkutil::transition_image(cmd, _drawImage.image, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_GENERAL);
-	vkutil::transition_image(cmd, surface.horizontal_map.image, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	//Only the output maps, the FFT fields may belong to the compute queue
 	vkutil::transition_image(cmd, surface.height_derivative.image, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-	vkutil::transition_image(cmd, surface.inital_spectrum_texture.image, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-	vkutil::transition_image(cmd, surface.conjugated_spectrum_texture.image, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-	vkutil::transition_image(cmd, surface.frequency_domain_texture.image, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-	vkutil::transition_image(cmd, surface.horizontal_displacement_map.image, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-	vkutil::transition_image(cmd, surface.height_derivative_texture.image, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-	vkutil::transition_image(cmd, surface.butterfly_texture.image, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-	vkutil::transition_image(cmd, surface.height_map.image, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 	vkutil::transition_image(cmd, surface.displacement_map.image, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 
 
@@ -1403,146 +2141,162 @@ void FFTRenderer::DebugComputePass(VkCommandBuffer cmd)
 	vkCmdDispatch(cmd, (_drawImage.imageExtent.width / 32) + 1, (_drawImage.imageExtent.height / 32) + 1, 1);
 	
 	vkutil::transition_image(cmd, _drawImage.image, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
-	vkutil::transition_image(cmd, surface.butterfly_texture.image, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_GENERAL);
-	vkutil::transition_image(cmd, surface.frequency_domain_texture.image, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_GENERAL);
-	vkutil::transition_image(cmd, surface.horizontal_displacement_map.image, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_GENERAL);
-	vkutil::transition_image(cmd, surface.height_derivative_texture.image, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_GENERAL);
-	vkutil::transition_image(cmd, surface.height_map.image, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_GENERAL);
-	vkutil::transition_image(cmd, surface.horizontal_map.image, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_GENERAL);
-	vkutil::transition_image(cmd, surface.conjugated_spectrum_texture.image, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,VK_IMAGE_LAYOUT_GENERAL);
 	vkutil::transition_image(cmd, surface.height_derivative.image, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_GENERAL);
 	vkutil::transition_image(cmd, surface.displacement_map.image, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,VK_IMAGE_LAYOUT_GENERAL);
 
 
 }
 
-void FFTRenderer::DoIFFT(VkCommandBuffer cmd, AllocatedImage* input, AllocatedImage* output)
+void FFTRenderer::DoIFFT(VkCommandBuffer cmd, AllocatedImage* input, AllocatedImage* output, uint32_t layer_count)
 {
-	AllocatedImage* ping_0 = input;
+	//The first stage reads input directly and the last one writes the sign permuted result, input stays untouched
+	AllocatedImage* ping_0 = output != nullptr ? output : input;
 	int ping_pong = 0;
 	ocean_params.log_size = log2(ocean_params.resolution);
-	if (output != nullptr)
+
+	if (single_workgroup_fft_supported)
 	{
-		//Copy input to output if output is specified
-		VkDescriptorSet copy_set = get_current_frame()._frameDescriptors.allocate(engine->_device, image_blit_layout);
+		//Rows, columns and the sign permutation in one dispatch, one workgroup per layer. Bound like the Stockham rows
+		VkDescriptorSet grid_set = compute_descriptors().allocate(engine->_device, fft_layout);
 		DescriptorWriter writer;
 
-		writer.write_image(0, input->imageView, samplerLinear, VK_IMAGE_LAYOUT_GENERAL, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
-		writer.write_image(1, output->imageView, samplerLinear, VK_IMAGE_LAYOUT_GENERAL, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
+		writer.write_image(0, ping_0->imageView, samplerLinear, VK_IMAGE_LAYOUT_GENERAL, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
+		writer.write_image(1, input->imageView, samplerLinear, VK_IMAGE_LAYOUT_GENERAL, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
+		writer.write_buffer(2, surface.twiddle_table.buffer, surface.texture_dimensions * sizeof(glm::vec2), 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
 
-		writer.update_set(engine->_device, copy_set);
+		writer.update_set(engine->_device, grid_set);
 
-		vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, copy_pso.pipeline);
+		vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, fft_2d_pso.pipeline);
 
-		vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, copy_pso.layout, 0, 1, &copy_set, 0, nullptr);
+		vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, fft_2d_pso.layout, 0, 1, &grid_set, 0, nullptr);
 
-		vkCmdDispatch(cmd, (surface.texture_dimensions / 32), (surface.texture_dimensions / 32), 1);
+		vkCmdDispatch(cmd, 1, 1, layer_count);
 
-		auto barrier = vkinit::image_barrier(output->image, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_ASPECT_COLOR_BIT);
-		vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_DEPENDENCY_BY_REGION_BIT, 0, 0, 0, 0, 1, &barrier);
-		ping_0 = output;
+		auto grid_barrier = vkinit::image_barrier(ping_0->image, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_ASPECT_COLOR_BIT);
+		vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_DEPENDENCY_BY_REGION_BIT, 0, 0, 0, 0, 1, &grid_barrier);
 	}
+	else if (use_shared_memory_fft)
+	{
+		//Stockham reads binding 1 and writes binding 0: rows go from input to ping_0, columns stay in ping_0
+		VkDescriptorSet horizontal_set = compute_descriptors().allocate(engine->_device, fft_layout);
+		DescriptorWriter writer_horizontal;
 
-	
-	VkDescriptorSet fft_set = get_current_frame()._frameDescriptors.allocate(engine->_device, fft_layout);
-	DescriptorWriter writer;
+		writer_horizontal.write_image(0, ping_0->imageView, samplerLinear, VK_IMAGE_LAYOUT_GENERAL, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
+		writer_horizontal.write_image(1, input->imageView, samplerLinear, VK_IMAGE_LAYOUT_GENERAL, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
+		writer_horizontal.write_buffer(2, surface.twiddle_table.buffer, surface.texture_dimensions * sizeof(glm::vec2), 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
 
-	writer.write_image(0, ping_0->imageView, samplerLinear, VK_IMAGE_LAYOUT_GENERAL, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
-	writer.write_image(1, surface.ping_1.imageView, samplerLinear, VK_IMAGE_LAYOUT_GENERAL, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
-	writer.write_image(2, surface.butterfly_texture.imageView, samplerLinear, VK_IMAGE_LAYOUT_GENERAL, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
+		writer_horizontal.update_set(engine->_device, horizontal_set);
 
+		VkDescriptorSet vertical_set = compute_descriptors().allocate(engine->_device, fft_layout);
+		DescriptorWriter writer_vertical;
 
-	writer.update_set(engine->_device, fft_set);
+		writer_vertical.write_image(0, ping_0->imageView, samplerLinear, VK_IMAGE_LAYOUT_GENERAL, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
+		writer_vertical.write_image(1, ping_0->imageView, samplerLinear, VK_IMAGE_LAYOUT_GENERAL, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
+		writer_vertical.write_buffer(2, surface.twiddle_table.buffer, surface.texture_dimensions * sizeof(glm::vec2), 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
 
-	for (int stage = 0; stage < ocean_params.log_size; stage++)
-	{
-		ocean_params.ping_pong_count = ping_pong;
-		ocean_params.stage = stage;
+		writer_vertical.update_set(engine->_device, vertical_set);
 
-		vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, fft_horizontal_pso.pipeline);
+		//Every stage of a row, then of a column, runs in shared memory: one dispatch and barrier per axis
+		vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, stockham_horizontal_pso.pipeline);
 
-		vkCmdPushConstants(cmd, fft_horizontal_pso.layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(FFTParams), &ocean_params);
+		vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, stockham_horizontal_pso.layout, 0, 1, &horizontal_set, 0, nullptr);
 
-		vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, fft_horizontal_pso.layout, 0, 1, &fft_set, 0, nullptr);
+		vkCmdDispatch(cmd, 1, surface.texture_dimensions, layer_count);
 
-		vkCmdDispatch(cmd, (surface.texture_dimensions / 32), (surface.texture_dimensions / 32), 1);
+		auto horizontal_barrier = vkinit::image_barrier(ping_0->image, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_ASPECT_COLOR_BIT);
+		vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_DEPENDENCY_BY_REGION_BIT, 0, 0, 0, 0, 1, &horizontal_barrier);
 
-		VkImageMemoryBarrier barrier;
-		if (ping_pong == 0)
-			barrier = vkinit::image_barrier(surface.ping_1.image, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_ASPECT_COLOR_BIT);
-		else
-			barrier = vkinit::image_barrier(ping_0->image, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_ASPECT_COLOR_BIT);
+		vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, stockham_vertical_pso.pipeline);
 
-		vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_DEPENDENCY_BY_REGION_BIT, 0, 0, 0, 0, 1, &barrier);
+		vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, stockham_vertical_pso.layout, 0, 1, &vertical_set, 0, nullptr);
 
-		ping_pong = (ping_pong + 1) % 2;
-	}
+		vkCmdDispatch(cmd, 1, surface.texture_dimensions, layer_count);
 
-	for (int stage = 0; stage < ocean_params.log_size; stage++)
+		auto vertical_barrier = vkinit::image_barrier(ping_0->image, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_ASPECT_COLOR_BIT);
+		vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_DEPENDENCY_BY_REGION_BIT, 0, 0, 0, 0, 1, &vertical_barrier);
+	}
+	else
 	{
-		ocean_params.ping_pong_count = ping_pong;
-		ocean_params.stage = stage;
+		VkDescriptorSet fft_set = compute_descriptors().allocate(engine->_device, fft_layout);
+		DescriptorWriter writer;
 
-		vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, fft_vertical_pso.pipeline);
+		writer.write_image(0, ping_0->imageView, samplerLinear, VK_IMAGE_LAYOUT_GENERAL, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
+		writer.write_image(1, surface.ping_1.imageView, samplerLinear, VK_IMAGE_LAYOUT_GENERAL, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
+		writer.write_buffer(2, surface.twiddle_table.buffer, surface.texture_dimensions * sizeof(glm::vec2), 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
 
-		vkCmdPushConstants(cmd, fft_vertical_pso.layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(FFTParams), &ocean_params);
+		writer.update_set(engine->_device, fft_set);
 
-		vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, fft_vertical_pso.layout, 0, 1, &fft_set, 0, nullptr);
+		//Same bindings with input in place of ping_0, used by the first horizontal stage only
+		VkDescriptorSet input_set = compute_descriptors().allocate(engine->_device, fft_layout);
+		DescriptorWriter writer_input;
 
-		vkCmdDispatch(cmd, (surface.texture_dimensions / 32), (surface.texture_dimensions / 32), 1);
-		
-		VkImageMemoryBarrier barrier;
-		if(ping_pong == 0)
-			barrier = vkinit::image_barrier(surface.ping_1.image, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_ASPECT_COLOR_BIT);
-		else
-			barrier = vkinit::image_barrier(ping_0->image, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_ASPECT_COLOR_BIT);
-		
-		vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_DEPENDENCY_BY_REGION_BIT, 0, 0, 0, 0, 1, &barrier);
-		ping_pong = (ping_pong + 1) % 2;
-	}
-	
-	
-	
-	//Copy output
-	VkDescriptorSet copy_set = get_current_frame()._frameDescriptors.allocate(engine->_device, image_blit_layout);
-	DescriptorWriter writer_copy;
+		writer_input.write_image(0, input->imageView, samplerLinear, VK_IMAGE_LAYOUT_GENERAL, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
+		writer_input.write_image(1, surface.ping_1.imageView, samplerLinear, VK_IMAGE_LAYOUT_GENERAL, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
+		writer_input.write_buffer(2, surface.twiddle_table.buffer, surface.texture_dimensions * sizeof(glm::vec2), 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
 
-	writer_copy.write_image(0, ping_0->imageView, samplerLinear, VK_IMAGE_LAYOUT_GENERAL, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
-	writer_copy.write_image(1, surface.ping_1.imageView, samplerLinear, VK_IMAGE_LAYOUT_GENERAL, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
+		writer_input.update_set(engine->_device, input_set);
 
-	writer_copy.update_set(engine->_device, copy_set);
+		//Radix-4 passes, the first one is radix-2 when log_size is odd. stage carries the pass index
+		const int pass_count = (ocean_params.log_size + 1) / 2;
+		auto butterfly_groups = [&](int pass) {
+			uint32_t radix = (ocean_params.log_size % 2 == 1 && pass == 0) ? 2 : 4;
+			return (surface.texture_dimensions / radix + 15) / 16;
+		};
 
-	vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, copy_pso.pipeline);
+		for (int stage = 0; stage < pass_count; stage++)
+		{
+			ocean_params.ping_pong_count = ping_pong;
+			ocean_params.stage = stage;
 
-	vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, copy_pso.layout, 0, 1, &copy_set, 0, nullptr);
+			vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, fft_horizontal_pso.pipeline);
 
-	vkCmdDispatch(cmd, (surface.texture_dimensions / 32), (surface.texture_dimensions / 32), 1);
+			vkCmdPushConstants(cmd, fft_horizontal_pso.layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(FFTParams), &ocean_params);
 
-	auto copy_barrier = vkinit::image_barrier(surface.ping_1.image, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_ASPECT_COLOR_BIT);
-	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_DEPENDENCY_BY_REGION_BIT, 0, 0, 0, 0, 1, &copy_barrier);
-	
-	VkDescriptorSet permute_set = get_current_frame()._frameDescriptors.allocate(engine->_device, image_blit_layout);
-	DescriptorWriter writer_permute;
+			VkDescriptorSet stage_set = stage == 0 ? input_set : fft_set;
+			vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, fft_horizontal_pso.layout, 0, 1, &stage_set, 0, nullptr);
 
-	writer_permute.write_image(0, ping_0->imageView, samplerLinear, VK_IMAGE_LAYOUT_GENERAL, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
-	writer_permute.write_image(1, surface.ping_1.imageView, samplerLinear, VK_IMAGE_LAYOUT_GENERAL, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
+			vkCmdDispatch(cmd, butterfly_groups(stage), (surface.texture_dimensions / 16), layer_count);
 
-	writer_permute.update_set(engine->_device, permute_set);
+			VkImageMemoryBarrier barrier;
+			if (ping_pong == 0)
+				barrier = vkinit::image_barrier(surface.ping_1.image, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_ASPECT_COLOR_BIT);
+			else
+				barrier = vkinit::image_barrier(ping_0->image, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_ASPECT_COLOR_BIT);
 
-	vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, permute_scale_pso.pipeline);
+			vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_DEPENDENCY_BY_REGION_BIT, 0, 0, 0, 0, 1, &barrier);
 
-	vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, permute_scale_pso.layout, 0, 1, &permute_set, 0, nullptr);
+			ping_pong = (ping_pong + 1) % 2;
+		}
 
-	vkCmdDispatch(cmd, (surface.texture_dimensions / 32), (surface.texture_dimensions / 32), 1);
+		//The last vertical pass applies the sign permutation and lands in ping_0, both axes run pass_count passes
+		for (int stage = 0; stage < pass_count; stage++)
+		{
+			ocean_params.ping_pong_count = ping_pong;
+			ocean_params.stage = stage;
 
-	auto barrier_permute = vkinit::image_barrier(ping_0->image, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_ASPECT_COLOR_BIT);
-	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_DEPENDENCY_BY_REGION_BIT, 0, 0, 0, 0, 1, &barrier_permute);
-	
+			vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, fft_vertical_pso.pipeline);
+
+			vkCmdPushConstants(cmd, fft_vertical_pso.layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(FFTParams), &ocean_params);
+
+			vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, fft_vertical_pso.layout, 0, 1, &fft_set, 0, nullptr);
+
+			vkCmdDispatch(cmd, (surface.texture_dimensions / 16), butterfly_groups(stage), layer_count);
+		
+			VkImageMemoryBarrier barrier;
+			if(ping_pong == 0)
+				barrier = vkinit::image_barrier(surface.ping_1.image, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_ASPECT_COLOR_BIT);
+			else
+				barrier = vkinit::image_barrier(ping_0->image, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_ASPECT_COLOR_BIT);
+		
+			vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_DEPENDENCY_BY_REGION_BIT, 0, 0, 0, 0, 1, &barrier);
+			ping_pong = (ping_pong + 1) % 2;
+		}
+	}
 }
 
-void FFTRenderer::WrapSpectrum(VkCommandBuffer cmd)
+void FFTRenderer::WrapSpectrum(VkCommandBuffer cmd, AllocatedImage* height_derivative, AllocatedImage* displacement)
 {
-	float currentFrame = glfwGetTime();
+	float currentFrame = ElapsedTime();
 	float deltaTime = currentFrame - delta.lastFrame;
 	delta.lastFrame = currentFrame;
 	ocean_params.ocean_size = surface.grid_dimensions;
@@ -1550,28 +2304,46 @@ void FFTRenderer::WrapSpectrum(VkCommandBuffer cmd)
 	ocean_params.delta_time = currentFrame;
 	//ocean_params.displacement_factor
 
-	VkDescriptorSet wrap_spectrum_set = get_current_frame()._frameDescriptors.allocate(engine->_device, wrap_spectrum_layout);
+	VkDescriptorSet wrap_spectrum_set = compute_descriptors().allocate(engine->_device, wrap_spectrum_layout);
 	DescriptorWriter writer;
 
-	writer.write_image(0, surface.height_derivative.imageView, samplerLinear, VK_IMAGE_LAYOUT_GENERAL, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
-	writer.write_image(1, surface.height_map.imageView, samplerLinear, VK_IMAGE_LAYOUT_GENERAL, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
-	writer.write_image(2, surface.horizontal_map.imageView, samplerLinear, VK_IMAGE_LAYOUT_GENERAL, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
-	writer.write_image(3, surface.displacement_map.imageView, samplerLinear, VK_IMAGE_LAYOUT_GENERAL, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
+	writer.write_image(0, surface.spatial_fields.imageView, samplerLinear, VK_IMAGE_LAYOUT_GENERAL, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
+	writer.write_image(1, height_derivative->imageView, samplerLinear, VK_IMAGE_LAYOUT_GENERAL, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
+	writer.write_image(2, displacement->imageView, samplerLinear, VK_IMAGE_LAYOUT_GENERAL, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
 
 	writer.update_set(engine->_device, wrap_spectrum_set);
 
 	vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, wrap_spectrum_pso.pipeline);
 
-	vkCmdPushConstants(cmd, wrap_spectrum_pso.layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(FFTParams), &ocean_params);
-
 	vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, wrap_spectrum_pso.layout, 0, 1, &wrap_spectrum_set, 0, nullptr);
 
-	vkCmdDispatch(cmd, (surface.texture_dimensions / 32), (surface.texture_dimensions / 32), 1);
+	//Same runs as the spectrum pass, each writes the update layer its cascades were scheduled into
+	for (const CascadeRun& run : cascade_runs)
+	{
+		FFTParams params = ocean_params;
+		params.cascade_base = int(run.first_cascade);
+		params.slot_base = int(run.first_slot);
+		params.key_layer = int(run.key_layer);
+		vkCmdPushConstants(cmd, wrap_spectrum_pso.layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(FFTParams), &params);
+		vkCmdDispatch(cmd, (surface.texture_dimensions / 32), (surface.texture_dimensions / 32), run.count);
+	}
 
 }
-void FFTRenderer::DrawMain(VkCommandBuffer cmd)
+VkImageLayout FFTRenderer::ScheduleFrame()
 {
+	//A new sea state drops the history before scheduling, so every cascade is due on the frame that builds its h0
 	if (sim_params.changed)
+		UpdateSeaState();
+	//Cascades skipped this frame are still read from the output maps, their contents only go when every cascade is rewritten
+	const VkImageLayout history_layout = cascade_history_valid ? VK_IMAGE_LAYOUT_GENERAL : VK_IMAGE_LAYOUT_UNDEFINED;
+	ScheduleCascades(ElapsedTime());
+	return history_layout;
+}
+
+void FFTRenderer::SimulateFrame(VkCommandBuffer cmd)
+{
+	ReclaimRetiredSpectra();
+	if (initial_spectrum_dirty)
 	{
 		GenerateInitialSpectrum(cmd);
 	}
@@ -1581,12 +2353,73 @@ void FFTRenderer::DrawMain(VkCommandBuffer cmd)
 
 	sim_params.is_ping_phase = !sim_params.is_ping_phase;
 
-	//Perform FFT on frequency textures
-	DoIFFT(cmd, &surface.frequency_domain_texture, &surface.height_map);
-	DoIFFT(cmd, &surface.height_derivative_texture, &surface.height_derivative);
-	DoIFFT(cmd, &surface.horizontal_displacement_map, &surface.horizontal_map);
-	WrapSpectrum(cmd);
+	//Only the cascades due this frame went through the spectrum pass, packed into the first slots.
+	//The others keep their last two updates and the renderer interpolates between them
+	if (scheduled_cascades != 0)
+		DoIFFT(cmd, &surface.spectrum_fields, &surface.spatial_fields, SPECTRUM_LAYER_COUNT * scheduled_cascades);
+}
+
+void FFTRenderer::SubmitAsyncSimulation(VkImageLayout history_layout)
+{
+	//Between two fixed rate steps nothing is due, no buffer is recorded and the maps keep their updates
+	if (scheduled_cascades == 0)
+		return;
+
+	BlackKey::FrameData& frame = get_current_frame();
+	VkCommandBufferBeginInfo cmdBeginInfo = vkinit::command_buffer_begin_info(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+
+	VkCommandBuffer compute_cmd = frame._computeCommandBuffer;
+	VK_CHECK(vkResetCommandBuffer(compute_cmd, 0));
+	VK_CHECK(vkBeginCommandBuffer(compute_cmd, &cmdBeginInfo));
+
+	vkutil::transition_image(compute_cmd, surface.ping_1.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+	vkutil::transition_image(compute_cmd, surface.jacobian_XxZz_map.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+	vkutil::transition_image(compute_cmd, surface.jacobian_xz_map.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+	vkutil::transition_image(compute_cmd, surface.spectrum_fields.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+	//Discarding the last frame's fields takes them back from the graphics family without an acquire
+	vkutil::transition_image(compute_cmd, surface.spatial_fields.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+
+	SimulateFrame(compute_cmd);
+
+	//The output maps keep the previous updates of every cascade and stay with the graphics queue. Only the IFFT
+	//result changes family: released here and acquired by the wrap pass with the same barrier
+	VkImageMemoryBarrier ownership = SpatialFieldsOwnership();
+	vkCmdPipelineBarrier(compute_cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &ownership);
+
+	VK_CHECK(vkEndCommandBuffer(compute_cmd));
+
+	//The previous wrap pass has to be done reading spatial_fields before this simulation overwrites them
+	VkSemaphoreSubmitInfo wrap_done = vkinit::semaphore_submit_info(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, graphics_timeline.semaphore);
+	wrap_done.value = last_wrap_value;
+	uint64_t simulated = SubmitTimeline(compute_timeline, compute_cmd, { wrap_done });
 
+	VkCommandBuffer wrap_cmd = frame._wrapCommandBuffer;
+	VK_CHECK(vkResetCommandBuffer(wrap_cmd, 0));
+	VK_CHECK(vkBeginCommandBuffer(wrap_cmd, &cmdBeginInfo));
+
+	vkutil::transition_image(wrap_cmd, surface.height_derivative.image, history_layout, VK_IMAGE_LAYOUT_GENERAL);
+	vkutil::transition_image(wrap_cmd, surface.displacement_map.image, history_layout, VK_IMAGE_LAYOUT_GENERAL);
+	vkCmdPipelineBarrier(wrap_cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &ownership);
+
+	WrapSpectrum(wrap_cmd, &surface.height_derivative, &surface.displacement_map);
+
+	VK_CHECK(vkEndCommandBuffer(wrap_cmd));
+
+	//Queue order puts the wrap after the last frame's draw and before this one's
+	VkSemaphoreSubmitInfo simulation_done = vkinit::semaphore_submit_info(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, compute_timeline.semaphore);
+	simulation_done.value = simulated;
+	last_wrap_value = SubmitTimeline(graphics_timeline, wrap_cmd, { simulation_done });
+}
+
+void FFTRenderer::DrawMain(VkCommandBuffer cmd)
+{
+	//Async compute has submitted the simulation and wrap pass already
+	if (!async_compute)
+	{
+		SimulateFrame(cmd);
+		if (scheduled_cascades != 0)
+			WrapSpectrum(cmd, &surface.height_derivative, &surface.displacement_map);
+	}
 	
 	vkutil::transition_image(cmd, surface.displacement_map.image, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 	vkutil::transition_image(cmd, surface.height_derivative.image, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
@@ -1614,14 +2447,12 @@ void FFTRenderer::DrawMain(VkCommandBuffer cmd)
 
 void FFTRenderer::Draw()
 {
-	auto start_update = std::chrono::system_clock::now();
-	//wait until the gpu has finished rendering the last frame. Timeout of 1 second
-	VK_CHECK(vkWaitForFences(engine->_device, 1, &get_current_frame()._renderFence, true, 1000000000));
+	//CPU waits of the previous frame, height queries included
+	stats.cpu_wait_time = cpu_wait_ms;
+	cpu_wait_ms = 0.0f;
 
-
-	auto end_update = std::chrono::system_clock::now();
-	auto elapsed_update = std::chrono::duration_cast<std::chrono::microseconds>(end_update - start_update);
-	stats.update_time = elapsed_update.count() / 1000.f;
+	//wait until the gpu has finished the last submission of this slot, frames_in_flight - 1 frames may still be running
+	WaitTimeline(graphics_timeline, get_current_frame()._timelineValue);
 
 	get_current_frame()._deletionQueue.flush();
 	get_current_frame()._frameDescriptors.clear_pools(engine->_device);
@@ -1638,8 +2469,6 @@ void FFTRenderer::Draw()
 	_drawExtent.height = std::min(_swapchainExtent.height, _drawImage.imageExtent.height);
 	_drawExtent.width = std::min(_swapchainExtent.width, _drawImage.imageExtent.width);
 
-	VK_CHECK(vkResetFences(engine->_device, 1, &get_current_frame()._renderFence));
-
 	//now that we are sure that the commands finished executing, we can safely reset the command buffer to begin recording again.
 	VK_CHECK(vkResetCommandBuffer(get_current_frame()._mainCommandBuffer, 0));
 
@@ -1656,20 +2485,22 @@ void FFTRenderer::Draw()
 	// we will overwrite it all so we dont care about what was the older layout
 	vkutil::transition_image(cmd, _drawImage.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
 	vkutil::transition_image(cmd, _depthImage.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL);
-	vkutil::transition_image(cmd, surface.inital_spectrum_texture.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
-	vkutil::transition_image(cmd, surface.horizontal_map.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
-	vkutil::transition_image(cmd, surface.height_derivative.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
-	vkutil::transition_image(cmd, surface.ping_1.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
-	vkutil::transition_image(cmd, surface.gaussian_noise_texture.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
-	vkutil::transition_image(cmd, surface.wave_texture.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
-	vkutil::transition_image(cmd, surface.conjugated_spectrum_texture.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
-	vkutil::transition_image(cmd, surface.jacobian_XxZz_map.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
-	vkutil::transition_image(cmd, surface.jacobian_xz_map.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
-	vkutil::transition_image(cmd, surface.height_derivative_texture.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
-	vkutil::transition_image(cmd, surface.frequency_domain_texture.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
-	vkutil::transition_image(cmd, surface.horizontal_displacement_map.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
-	vkutil::transition_image(cmd, surface.height_map.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
-	vkutil::transition_image(cmd, surface.displacement_map.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+	const VkImageLayout history_layout = ScheduleFrame();
+	if (async_compute)
+	{
+		//Submitted ahead of cmd, so the simulation runs while the previous frame is still rasterising
+		SubmitAsyncSimulation(history_layout);
+	}
+	else
+	{
+		vkutil::transition_image(cmd, surface.height_derivative.image, history_layout, VK_IMAGE_LAYOUT_GENERAL);
+		vkutil::transition_image(cmd, surface.ping_1.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+		vkutil::transition_image(cmd, surface.jacobian_XxZz_map.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+		vkutil::transition_image(cmd, surface.jacobian_xz_map.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+		vkutil::transition_image(cmd, surface.spectrum_fields.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+		vkutil::transition_image(cmd, surface.spatial_fields.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+		vkutil::transition_image(cmd, surface.displacement_map.image, history_layout, VK_IMAGE_LAYOUT_GENERAL);
+	}
 
 	DrawMain(cmd);
 
@@ -1698,16 +2529,12 @@ void FFTRenderer::Draw()
 	//we want to wait on the _presentSemaphore, as that semaphore is signaled when the swapchain is ready
 	//we will signal the _renderSemaphore, to signal that rendering has finished
 
-	VkCommandBufferSubmitInfo cmdinfo = vkinit::command_buffer_submit_info(cmd);
-
 	VkSemaphoreSubmitInfo waitInfo = vkinit::semaphore_submit_info(VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR, get_current_frame()._swapchainSemaphore);
 	VkSemaphoreSubmitInfo signalInfo = vkinit::semaphore_submit_info(VK_PIPELINE_STAGE_2_ALL_GRAPHICS_BIT, get_current_frame()._renderSemaphore);
 
-	VkSubmitInfo2 submit = vkinit::submit_info(&cmdinfo, &signalInfo, &waitInfo);
-
 	//submit command buffer to the queue and execute it.
-	// _renderFence will now block until the graphic commands finish execution
-	VK_CHECK(vkQueueSubmit2(engine->_graphicsQueue, 1, &submit, get_current_frame()._renderFence));
+	//the slot is reused once the graphics timeline reaches the value this submission signals
+	get_current_frame()._timelineValue = SubmitTimeline(graphics_timeline, cmd, { waitInfo }, &signalInfo);
 
 	//prepare present
 	// this will put the image we just rendered to into the visible window.
@@ -1780,6 +2607,7 @@ void FFTRenderer::Run()
 		UpdateScene();
 		auto end_update = std::chrono::system_clock::now();
 		auto elapsed_update = std::chrono::duration_cast<std::chrono::microseconds>(end_update - start_update);
+		stats.update_time = elapsed_update.count() / 1000.f;
 		Draw();
 		glfwPollEvents();
 		auto end = std::chrono::system_clock::now();
@@ -1880,11 +2708,62 @@ void FFTRenderer::DrawUI()
 		bool wind_mag_changed = ImGui::SliderFloat("Wind Magnitude", &sim_params.wind_magnitude, 2.f, 50.f);
 		bool wind_dir_changed = ImGui::SliderFloat("Wind Angle", &sim_params.wind_angle, 0, 359);
 
+		static const char* spectrum_models[] = { "Phillips", "Pierson-Moskowitz", "JONSWAP" };
+		static const char* spreading_models[] = { "cos^2", "Donelan-Banner + swell" };
+		int spectrum_model = int(sim_params.spectrum_model);
+		int spreading = int(sim_params.spreading);
+		bool model_changed = ImGui::Combo("Spectrum", &spectrum_model, spectrum_models, IM_ARRAYSIZE(spectrum_models));
+		bool spreading_changed = ImGui::Combo("Directional spreading", &spreading, spreading_models, IM_ARRAYSIZE(spreading_models));
+		bool depth_changed = ImGui::Checkbox("TMA depth correction", &sim_params.tma_depth);
+		sim_params.spectrum_model = SpectrumModel(spectrum_model);
+		sim_params.spreading = DirectionalSpreading(spreading);
+
 		ImGui::SliderFloat("Choppiness", &ocean_params.displacement_factor, 0.f, 3.5f);
 		ImGui::Checkbox("Debug texture", &debug_texture);
-
-
-		sim_params.changed = wind_mag_changed || wind_dir_changed;
+		ImGui::Text("FFT resolution %u x %u", surface.texture_dimensions, surface.texture_dimensions);
+		ImGui::Text("Field storage %s", half_precision ? "FP16" : "FP32");
+		ImGui::Text("Cascades %u, smallest patch %.1f m", cascade_count, CascadePatchSize(cascade_count - 1));
+		ImGui::Text("Simulation queue %s", async_compute ? "async compute" : "graphics");
+		int frames = int(frames_in_flight);
+		if (ImGui::SliderInt("Frames in flight", &frames, 1, MAX_FRAMES_IN_FLIGHT))
+			SetFramesInFlight(uint32_t(frames));
+		float cascade_updates = 0.0f;
+		for (uint32_t cascade = 0; cascade < cascade_count; cascade++)
+		{
+			const char* update_periods[] = { "Every step", "Every 2nd step", "Every 4th step", "Every 8th step" };
+			int period_index = 0;
+			while ((1u << period_index) < cascades[cascade].period)
+				period_index++;
+			std::string label = "Cascade " + std::to_string(cascade) + " update";
+			if (ImGui::Combo(label.c_str(), &period_index, update_periods, IM_ARRAYSIZE(update_periods)))
+				SetCascadeUpdatePeriod(cascade, 1u << period_index);
+			cascade_updates += 1.0f / float(cascades[cascade].period);
+		}
+		ImGui::Text("Cascade updates per step %.2f of %u", cascade_updates, cascade_count);
+		bool fixed_rate = simulation_rate > 0.0f;
+		if (ImGui::Checkbox("Fixed simulation rate", &fixed_rate))
+			SetSimulationRate(fixed_rate ? DEFAULT_SIMULATION_RATE : 0.0f);
+		if (fixed_rate)
+		{
+			float rate = simulation_rate;
+			if (ImGui::SliderFloat("Simulation rate (Hz)", &rate, MIN_SIMULATION_RATE, MAX_SIMULATION_RATE))
+				SetSimulationRate(rate);
+		}
+		ImGui::Text("Simulated steps per second %.1f", simulated_steps_per_second);
+		ImGui::Checkbox("Incremental phase", &incremental_phase);
+		ImGui::Text("Cached sea states %zu, %.1f of %.1f MB", spectrum_cache.size(),
+			spectrum_cache.size() * SpectrumBytes() / (1024.0 * 1024.0), spectrum_cache_budget / (1024.0 * 1024.0));
+		if (single_workgroup_fft_supported)
+			ImGui::Text("2D FFT in one workgroup per field");
+		else if (shared_fft_supported)
+			ImGui::Checkbox("Single dispatch FFT", &use_shared_memory_fft);
+		if (!single_workgroup_fft_supported && shared_fft_supported && subgroup_fft_supported)
+			ImGui::Text("Subgroup shuffle butterflies, %u lanes", subgroup_size);
+
+
+		//Raised here or by SetSeed, cleared once the initial spectrum has been rebuilt
+		if (wind_mag_changed || wind_dir_changed || model_changed || spreading_changed || depth_changed)
+			sim_params.changed = true;
 	}
 	if (ImGui::CollapsingHeader("Lighting"))
 	{
@@ -1930,6 +2809,7 @@ void FFTRenderer::DrawUI()
 		ImGui::Text("Indirect Draws: %i", stats.drawcall_count);
 		ImGui::Text("UI render time %f ms", stats.ui_draw_time);
 		ImGui::Text("Update time %f ms", stats.update_time);
+		ImGui::Text("CPU wait %f ms", stats.cpu_wait_time);
 		ImGui::Text("Shadow Pass time %f ms", stats.shadow_pass_time);
 	}
 	ImGui::End();
@@ -3,6 +3,12 @@
 
 #include "base_renderer.h"
 #include "../vk_engine.h"
+#include "ocean_query.h"
+#include "ocean_spectrum.h"
+
+#include <initializer_list>
+#include <list>
+#include <map>
 
 struct OceanUBO {
 	glm::vec3 cam_pos;
@@ -21,8 +27,19 @@ struct OceanUBO {
 	float foam;
 	glm::vec4 ambient = glm::vec4(0.02, 0.04, 0.06, 1);
 	glm::vec4 fresnel_color = glm::vec4(1.0f);
+	//Patch sizes of the cascades summed by ocean.vert and ocean.frag
+	glm::vec4 cascade_sizes = glm::vec4(0.0f);
+	//Weight of the newest of the two updates kept per cascade, and which of its two layers holds it
+	glm::vec4 cascade_blend = glm::vec4(1.0f);
+	glm::ivec4 cascade_newest_key = glm::ivec4(0);
+	int cascade_count = 1;
+	int cascade_padding[3];
 };
 
+//Initial spectrum variants, the values are constant_id 0 and 1 of initial_spectrum.comp
+enum class SpectrumModel : uint32_t { Phillips, PiersonMoskowitz, JONSWAP };
+enum class DirectionalSpreading : uint32_t { CosineSquared, DonelanSwell };
+
 struct HeightSimParams {
 	float wind_angle = 45.f;
 	float wind_magnitude = 5.142135f;
@@ -31,11 +48,19 @@ struct HeightSimParams {
 	float time_value = 1.0f;
 	bool wireframe;
 	bool changed = true;
+	uint64_t seed = 0;
+	SpectrumModel spectrum_model = SpectrumModel::JONSWAP;
+	DirectionalSpreading spreading = DirectionalSpreading::DonelanSwell;
+	//TMA finite depth correction, shallow water damps the low frequencies
+	bool tma_depth = true;
 	bool is_ping_phase = true;
 	bool use_temp_texture = true;
 	bool save_height_values = false;
 };
 
+//Layers of the cascade arrays are sized for this many, FFTRenderer::SetCascadeCount picks how many run
+constexpr uint32_t MAX_CASCADES = 4;
+
 struct FFTParams {
 	int resolution;
 	int ocean_size;
@@ -52,45 +77,256 @@ struct FFTParams {
 	float displacement_factor = 0.9f;
 	float foam_intensity;
 	float foam_decay;
+	//Noise seed of the initial spectrum, GLSL has no 64 bit push constant without an extension
+	uint32_t seed_low;
+	uint32_t seed_high;
+	//Absolute time split into float(t) and the remainder, so the phase keeps double precision
+	float time_high;
+	float time_low;
+	//Incremental phase mode, see FFTRenderer::AdvancePhase
+	int step_count;
+	int phase_flags;
+	//World size of each cascade's patch, cascade c is layer c of the initial spectrum array
+	float cascade_sizes[MAX_CASCADES];
+	int cascade_count;
+	//Cascade simulated by workgroup z = 0 and the IFFT slot it goes through, see FFTRenderer::CascadeRun
+	int cascade_base;
+	int slot_base;
+	//Which of the two update layers of its cascade the wrap pass writes
+	int key_layer;
+};
+//Push constants of get_value.comp
+struct HeightSampleParams {
+	uint32_t point_count;
+	uint32_t cascade_count;
+	float cascade_sizes[MAX_CASCADES];
 };
+//Specialization constants of the size dependent FFT kernels, constant_id follows member order
+struct FFTSpecialization {
+	VkBool32 horizontal = VK_TRUE;
+	uint32_t resolution;
+	uint32_t log_size;
+	uint32_t line_threads;
+};
+//Specialization constants of initial_spectrum.comp, constant_id follows member order
+struct SpectrumSpecialization {
+	SpectrumModel model;
+	DirectionalSpreading spreading;
+	VkBool32 tma_depth;
+};
+
 struct OceanVertex {
 	glm::vec4 position;
 	glm::vec2 uv;
 	glm::vec2 pad;
 };
 
+//Layers of the batched IFFT arrays. Each texel packs two complex signals and each signal two real fields (A + iB),
+//so height, horizontal displacement and both slopes fit in two layers
+constexpr uint32_t SPECTRUM_LAYER_COUNT = 2;
+
+//Supported FFT resolutions, any power of two in between
+constexpr uint32_t MIN_FFT_RESOLUTION = 64;
+constexpr uint32_t MAX_FFT_RESOLUTION = 4096;
+//Up to this size DoIFFT runs the whole 2D transform of a field in one workgroup
+constexpr uint32_t MAX_SINGLE_WORKGROUP_FFT_RESOLUTION = 64;
+//Interval the incremental phasors advance by, several steps are applied per frame
+constexpr double PHASE_STEP = 1.0 / 240.0;
+//A longer gap, e.g. after a hitch, restarts the phasors from the absolute time instead
+constexpr uint32_t MAX_PHASE_STEPS_PER_FRAME = 32;
+//Steps after which the phasors are evaluated from the absolute phase again
+constexpr uint64_t PHASE_REANCHOR_INTERVAL = 256;
+//phase_flags of FFTParams
+constexpr int PHASE_RESET = 1;
+//Patch size ratio between neighbouring cascades, not a whole number so their tilings never line up
+constexpr float CASCADE_SIZE_RATIO = 5.77f;
+//Longest update period of a cascade, in simulation steps. Periods are powers of two so the schedule repeats every MAX_CASCADE_PERIOD steps
+constexpr uint32_t MAX_CASCADE_PERIOD = 8;
+//Output maps keep the last two updates of every cascade, layer 2c + key
+constexpr uint32_t CASCADE_KEY_COUNT = 2;
+//Fixed simulation rates, in Hz. Above PHASE_STEP's 240 Hz the phasors could not advance every tick
+constexpr float MIN_SIMULATION_RATE = 15.0f;
+constexpr float MAX_SIMULATION_RATE = 240.0f;
+constexpr float DEFAULT_SIMULATION_RATE = 30.0f;
+//VRAM kept for initial spectra of recent sea states, 32 spectra at 512 x 512
+constexpr VkDeviceSize DEFAULT_SPECTRUM_CACHE_BUDGET = 64ull * 1024 * 1024;
+
+//Everything the initial spectrum depends on, key of the h0 cache
+struct SeaStateKey {
+	float wind_speed;
+	float wind_angle;
+	float fetch;
+	float depth;
+	float swell;
+	uint64_t seed;
+	uint32_t resolution;
+	SpectrumModel model;
+	DirectionalSpreading spreading;
+	bool tma_depth;
+
+	bool operator==(const SeaStateKey& other) const
+	{
+		return wind_speed == other.wind_speed && wind_angle == other.wind_angle && fetch == other.fetch && depth == other.depth &&
+			swell == other.swell && seed == other.seed && resolution == other.resolution && model == other.model &&
+			spreading == other.spreading && tma_depth == other.tma_depth;
+	}
+};
+
+//Update schedule of a cascade and the state that carries it between its updates
+struct CascadeState {
+	//Simulated on the steps where (step + offset) % period == 0, a step is a frame or a tick of the fixed rate
+	uint32_t period = 1;
+	uint32_t offset = 0;
+	//Layer key of the cascade holds the update for key_time, the other one the update before it
+	uint32_t newest_key = 0;
+	double key_time = 0.0;
+	double previous_key_time = 0.0;
+	//Incremental phasors of the cascade's modes, see FFTRenderer::AdvancePhase
+	bool phase_valid = false;
+	//Time the phasors currently represent, a multiple of PHASE_STEP after the last reset
+	double phase_time = 0.0;
+	//Steps since the phasors were last evaluated from phase_time
+	uint64_t phase_steps_taken = 0;
+};
+
+//Cascades first_cascade .. first_cascade + count - 1 simulated by one dispatch of each pass.
+//They go through IFFT slots first_slot onward, the layers 2s and 2s + 1 of the spectrum arrays
+struct CascadeRun {
+	uint32_t first_cascade;
+	uint32_t first_slot;
+	uint32_t count;
+	uint32_t key_layer;
+	FFTParams params;
+};
+
+struct CachedSpectrum {
+	SeaStateKey key;
+	AllocatedImage image;
+};
+
+//Evicted h0 waiting for the simulation queue's timeline to pass the last submission that could read it
+struct RetiredSpectrum {
+	AllocatedImage image;
+	uint64_t timeline_value;
+};
+
 struct OceanSurface {
 	std::vector<OceanVertex> vertices;
 	std::vector<uint32_t> indices;
 	
 	GPUMeshBuffers mesh_data;
 
-	uint32_t grid_dimensions = 1024;
+	//World size of the mesh and of the first cascade's patch, fixed so the resolution only changes the detail
+	uint32_t grid_dimensions = 512;
 	uint32_t texture_dimensions = 512;
 
 	AllocatedImage height_derivative;
-	AllocatedImage frequency_domain_texture;
-	AllocatedImage height_derivative_texture;
-	AllocatedImage horizontal_displacement_map;
+	AllocatedImage spectrum_fields;
+	AllocatedImage spatial_fields;
 	AllocatedImage jacobian_XxZz_map;
 	AllocatedImage jacobian_xz_map;
 	AllocatedImage ping_1;
-	AllocatedImage butterfly_texture;
 	AllocatedImage inital_spectrum_texture;
 	AllocatedImage normal_map;
-	AllocatedImage gaussian_noise_texture;
-	AllocatedImage wave_texture;
-	AllocatedImage conjugated_spectrum_texture;
-	AllocatedImage horizontal_map;
-	AllocatedImage height_map;
 	AllocatedImage displacement_map;
+	//Output maps of height queries, layer 2c holds cascade c at the last queried time
+	AllocatedImage query_displacement_map;
+	AllocatedImage query_height_derivative;
 	AllocatedImage sky_image;
-	AllocatedBuffer height_buffer;
-	AllocatedBuffer sampled_value;
+	//exp(2 pi i m / N) for m < N, shared by every FFT kernel
+	AllocatedBuffer twiddle_table;
+	//exp(i omega t) per mode and its per step rotation, state of the incremental phase mode
+	AllocatedBuffer phasors;
+	AllocatedBuffer phasor_steps;
 };
-struct FFTRenderer : public BaseRenderer
+
+//Entries allocated for the height query ring, FFTRenderer::HeightQuerySlots of them are used
+constexpr uint32_t MAX_HEIGHT_QUERY_SLOTS = MAX_FRAMES_IN_FLIGHT + 1;
+
+//Handle to an in-flight height query. Results stay readable until the ring slot is reused HeightQuerySlots() requests later
+struct HeightQueryTicket {
+	uint64_t id = 0;
+	uint32_t slot = 0;
+};
+
+//Result of collecting a height query. An expired ticket's slot went to a newer query, polling it again never succeeds
+enum class HeightQueryStatus {
+	Ready,
+	Pending,
+	Expired
+};
+
+//One entry of the height query ring, with its own submission and persistently mapped readback buffers
+struct HeightQuerySlot {
+	VkCommandPool command_pool;
+	VkCommandBuffer command_buffer;
+	//Spectrum and IFFT passes of the query when they run on the compute queue
+	VkCommandPool compute_command_pool;
+	VkCommandBuffer compute_command_buffer;
+	//Graphics timeline value of the submission that writes the results
+	uint64_t timeline_value = 0;
+	DescriptorAllocatorGrowable descriptors;
+	AllocatedBuffer points;
+	AllocatedBuffer heights;
+	size_t capacity = 0;
+	size_t count = 0;
+	uint64_t ticket = 0;
+	bool pending = false;
+};
+
+//Timeline semaphore of one queue, every submission to it signals the next value
+struct QueueTimeline {
+	VkQueue queue = VK_NULL_HANDLE;
+	VkSemaphore semaphore = VK_NULL_HANDLE;
+	//Last value handed to a submission
+	uint64_t value = 0;
+};
+
+struct FFTRenderer : public BaseRenderer, public OceanHeightQuery
 {
 	void Init(VulkanEngine* engine) override;
+	//Compute only setup for display-less machines: device, queue, FFT images and pipelines.
+	//No window, swapchain or UI, the simulation is driven through Simulate/GetHeights instead of Run
+	void InitHeadless(VulkanEngine* engine);
+	//FFT grid size, has to be called before Init/InitHeadless. Returns false and keeps the current size
+	//unless resolution is a power of two between MIN_FFT_RESOLUTION and MAX_FFT_RESOLUTION
+	bool SetResolution(uint32_t resolution);
+	uint32_t Resolution() const { return surface.texture_dimensions; }
+	//Stores spectra, FFT scratch and output maps as R16G16B16A16_SFLOAT, halving their bandwidth.
+	//Has to be called before Init/InitHeadless, the FFT arithmetic itself stays FP32
+	bool SetHalfPrecision(bool enabled);
+	bool HalfPrecision() const { return half_precision; }
+	//Number of cascades, 1 to MAX_CASCADES, has to be called before Init/InitHeadless. The first cascade's patch is
+	//grid_dimensions metres wide at any resolution and every further one CASCADE_SIZE_RATIO times smaller, each simulating its own band of k
+	bool SetCascadeCount(uint32_t count);
+	uint32_t CascadeCount() const { return cascade_count; }
+	float CascadePatchSize(uint32_t cascade) const;
+	//Steps between updates of a cascade, a power of two up to MAX_CASCADE_PERIOD. SetCascadeCount defaults to
+	//updating the largest patches least often; rendering interpolates between a cascade's last two updates
+	bool SetCascadeUpdatePeriod(uint32_t cascade, uint32_t period);
+	uint32_t CascadeUpdatePeriod(uint32_t cascade) const { return cascades[cascade].period; }
+	//Runs the simulation at a fixed rate in Hz instead of once per rendered frame, frames between two steps only
+	//interpolate. 0 goes back to one step per frame, otherwise the rate has to be within MIN/MAX_SIMULATION_RATE
+	bool SetSimulationRate(float hz);
+	float SimulationRate() const { return simulation_rate; }
+	//Submits the spectrum and IFFT passes to a compute queue family of their own, so they overlap the previous frame's
+	//rasterisation. Has to be called before Init, stays off in headless mode and on devices without such a family
+	void SetAsyncCompute(bool enabled) { async_compute_requested = enabled; }
+	bool AsyncCompute() const { return async_compute; }
+	//Frames the CPU may record ahead of the GPU, 1 to MAX_FRAMES_IN_FLIGHT. Can change at any time, more frames
+	//trade latency for throughput
+	bool SetFramesInFlight(uint32_t count);
+	uint32_t FramesInFlight() const { return frames_in_flight; }
+	//Key of the Gaussian noise hashed in initial_spectrum.comp, the same seed gives the same sea on every run
+	void SetSeed(uint64_t seed);
+	uint64_t Seed() const { return sim_params.seed; }
+	//Spectrum model, directional spreading and depth correction of the initial spectrum, JONSWAP with Donelan-Banner
+	//spreading and TMA by default. Each combination compiles its own pipeline the first time it is used
+	void SetSpectrumModel(SpectrumModel model, DirectionalSpreading spreading, bool tma_depth);
+	//Initial spectra of recently used sea states stay in VRAM up to this many bytes, least recently used evicted first.
+	//The active spectrum is always kept, even when it alone exceeds the budget
+	void SetSpectrumCacheBudget(VkDeviceSize bytes) { spectrum_cache_budget = bytes; }
+	VkDeviceSize SpectrumCacheBudget() const { return spectrum_cache_budget; }
 
 	void Cleanup() override;
 
@@ -103,15 +339,45 @@ struct FFTRenderer : public BaseRenderer
 	void InitImgui() override;
 
 	void DrawMain(VkCommandBuffer cmd);
+	//Applies sea state changes and picks the cascades due this frame, before anything is recorded.
+	//Returns the layout the output maps are in
+	VkImageLayout ScheduleFrame();
+	//Spectrum and IFFT passes of the frame, the wrap pass is recorded separately
+	void SimulateFrame(VkCommandBuffer cmd);
+	//Records the simulation on the compute queue and the wrap pass on the graphics queue, chained by semaphores.
+	//Nothing is recorded when ScheduleFrame found no cascade due
+	void SubmitAsyncSimulation(VkImageLayout history_layout);
+	//Submits cmd after waits, signalling the timeline's next value and optionally a binary semaphore. Returns the value
+	uint64_t SubmitTimeline(QueueTimeline& timeline, VkCommandBuffer cmd, std::initializer_list<VkSemaphoreSubmitInfo> waits, const VkSemaphoreSubmitInfo* binary_signal = nullptr);
+	//Blocks until the timeline reaches value, the time spent counts towards stats.cpu_wait_time
+	void WaitTimeline(const QueueTimeline& timeline, uint64_t value);
+	//Destroys the evicted spectra no submission reads any more, polled from WaitTimeline and SimulateFrame
+	void ReclaimRetiredSpectra();
 	void DrawImgui(VkCommandBuffer cmd, VkImageView targetImageView);
 	void BuildOceanMesh();
 	void DrawOceanMesh(VkCommandBuffer cmd);
+	//Sea state parameters of sim_params into ocean_params, a new SeaStateKey restarts the history
+	void UpdateSeaState();
+	//Binds the h0 of active_sea_state, from the cache or generated into cmd
 	void GenerateInitialSpectrum(VkCommandBuffer cmd);
-	void GenerateSpectrum(VkCommandBuffer cmd, float time = -1.0);
+	bool UseCachedSpectrum(const SeaStateKey& key);
+	AllocatedImage AllocateCachedSpectrum(VkCommandBuffer cmd, const SeaStateKey& key);
+	const PipelineStateObject& InitialSpectrumPSO(const SpectrumSpecialization& specialization);
+	VkDeviceSize SpectrumBytes() const;
+	VkDeviceSize PhasorBytes() const;
+	//time < 0 follows the wall clock with the incremental phasors, an explicit time is evaluated directly
+	void GenerateSpectrum(VkCommandBuffer cmd, double time = -1.0);
+	//Picks the cascades due this frame, their key times and phase parameters, and groups them into cascade_runs
+	void ScheduleCascades(double now);
+	//Spreads the cascade offsets so every frame simulates about the same number of cascades
+	void BalanceCascadeOffsets();
+	void AdvancePhase(CascadeState& cascade, double time);
+	void SetAbsoluteTime(double time);
 	void DebugComputePass(VkCommandBuffer cmd);
 	void PreProcessComputePass();
-	void WrapSpectrum(VkCommandBuffer cmd);
-	void DoIFFT(VkCommandBuffer cmd, AllocatedImage* input = nullptr, AllocatedImage* output = nullptr);
+	//Writes the IFFT result of the scheduled cascades into the output maps, the renderer's or the query's
+	void WrapSpectrum(VkCommandBuffer cmd, AllocatedImage* height_derivative, AllocatedImage* displacement);
+	void DoIFFT(VkCommandBuffer cmd, AllocatedImage* input = nullptr, AllocatedImage* output = nullptr, uint32_t layer_count = SPECTRUM_LAYER_COUNT);
 
 	void ConfigureRenderWindow();
 	void InitEngine();
@@ -125,6 +391,17 @@ struct FFTRenderer : public BaseRenderer
 	void InitBuffers();
 	void InitPipelines();
 	float GetHeightValues(const double x, const double y, const double t);
+	void GetHeights(const OceanPoint* points, size_t count, double t, float* out) override;
+	HeightQueryTicket RequestHeights(const OceanPoint* points, size_t count, double t);
+	HeightQueryStatus TryGetHeights(const HeightQueryTicket& ticket, float* out);
+	//Blocks until the query lands, never returns Pending
+	HeightQueryStatus WaitHeights(const HeightQueryTicket& ticket, float* out);
+	//Runs the spectrum, IFFT and wrap passes for time t and waits for them to finish
+	void Simulate(double t);
+	//Copies the RGBA displacement map of the last simulated time to the host
+	void ReadDisplacementMap(std::vector<float>& out);
+	//Sea state of the first cascade as CPUOceanSimulator parameters, both then simulate the same ocean
+	OceanParams ReferenceParams() const;
 
 	void CreateSwapchain(uint32_t width, uint32_t height);
 	void DestroySwapchain();
@@ -135,19 +412,27 @@ struct FFTRenderer : public BaseRenderer
 	static void FramebufferResizeCallback(GLFWwindow* window, int width, int height);
 
 private:
+	void SimulateAt(VkCommandBuffer cmd, double t);
+	//Hands spatial_fields from the compute family to graphics between the IFFT and the wrap pass
+	VkImageMemoryBarrier SpatialFieldsOwnership() const;
+	void InitHeightQueries();
+	void ReserveQueryBuffers(HeightQuerySlot& slot, size_t count);
+	double ElapsedTime();
+	VkFormat FieldFormat() const;
+	std::string FieldShaderPath(const char* name) const;
+	DescriptorAllocatorGrowable& compute_descriptors() { return descriptor_override ? *descriptor_override : get_current_frame()._frameDescriptors; };
+
 	OceanSurface surface;
 	DrawContext drawCommands;
 	DrawContext skyDrawCommands;
 
 	VkDescriptorSetLayout skybox_descriptor_layout;
 	VkDescriptorSetLayout spectrum_layout;
-	VkDescriptorSetLayout butterfly_layout;
 	VkDescriptorSetLayout image_blit_layout;
 	VkDescriptorSetLayout ocean_shading_layout;
 	VkDescriptorSetLayout debug_layout;
 	VkDescriptorSetLayout wrap_spectrum_layout;
 	VkDescriptorSetLayout fft_layout;
-	VkDescriptorSetLayout height_copy_layout;
 	VkDescriptorSetLayout height_sample_layout;
 	std::vector<VkImageMemoryBarrier> image_barriers;
 	
@@ -168,20 +453,75 @@ private:
 
 	std::vector<vkutil::MaterialPass> forward_passes;
 
-	BlackKey::FrameData _frames[FRAME_OVERLAP];
-	BlackKey::FrameData& get_current_frame() { return _frames[_frameNumber % FRAME_OVERLAP]; };
+	BlackKey::FrameData _frames[MAX_FRAMES_IN_FLIGHT];
+	BlackKey::FrameData& get_current_frame() { return _frames[_frameNumber % frames_in_flight]; };
+	uint32_t frames_in_flight = DEFAULT_FRAMES_IN_FLIGHT;
+	QueueTimeline graphics_timeline;
+	//Same queue as graphics_timeline without a separate compute family, a semaphore of its own either way
+	QueueTimeline compute_timeline;
+	//Milliseconds blocked in WaitTimeline since the last frame started
+	float cpu_wait_ms = 0.0f;
+
+	HeightQuerySlot height_queries[MAX_HEIGHT_QUERY_SLOTS];
+	//One outstanding request per frame in flight plus the one being made, so polling a frame's query never blocks
+	uint32_t HeightQuerySlots() const { return frames_in_flight + 1; }
+	uint64_t next_query_ticket = 1;
+	DescriptorAllocatorGrowable* descriptor_override = nullptr;
 
-	std::vector<float> height_values;
 	bool resize_requested = false;
 	bool _isInitialized{ false };
+	bool headless = false;
+	std::chrono::steady_clock::time_point start_time = std::chrono::steady_clock::now();
 	int _frameNumber{ 0 };
 	bool stop_rendering{ false };
 	bool use_bindless = true;
 	bool debugBuffer = false;
 	bool readDebugBuffer = false;
 	bool debug_texture = false;
+	//Single dispatch per axis FFT in shared memory, falls back to per stage dispatches when the device limits are too small
+	bool shared_fft_supported = false;
+	bool use_shared_memory_fft = true;
+	//The single dispatch FFT runs fft_subgroup.comp instead of fft_stockham.comp, from VkPhysicalDeviceSubgroupProperties
+	bool subgroup_fft_supported = false;
+	//Resolution at most MAX_SINGLE_WORKGROUP_FFT_RESOLUTION and the vec2 grid fits in shared memory
+	bool single_workgroup_fft_supported = false;
+	uint32_t subgroup_size = 0;
+	bool half_precision = false;
+	uint32_t cascade_count = 1;
+	CascadeState cascades[MAX_CASCADES];
+	//Cascades simulated by the current frame, consumed by the spectrum, IFFT and wrap passes
+	std::vector<CascadeRun> cascade_runs;
+	uint32_t scheduled_cascades = 0;
+	//Frames since startup, drives the cascade schedule when every frame is a simulation step
+	uint64_t simulation_frame = 0;
+	//Fixed rate mode, step n simulates the ocean at n / simulation_rate. 0 steps once per frame
+	float simulation_rate = 0.0f;
+	uint64_t last_simulation_step = 0;
+	//Frames that ran the spectrum pass, counted per window for the UI
+	uint32_t simulated_steps = 0;
+	double simulated_steps_start = 0.0;
+	float simulated_steps_per_second = 0.0f;
+	//Smoothed wall clock time between frames, how far ahead a decimated cascade is simulated
+	double frame_interval = 1.0 / 60.0;
+	double last_schedule_time = -1.0;
+	//False until every cascade has been simulated once since the maps were last overwritten, e.g. after a sea state change
+	bool cascade_history_valid = false;
+	bool cascade_offsets_dirty = true;
+	bool async_compute_requested = false;
+	bool async_compute = false;
+	//Graphics timeline value of the last wrap pass, the next simulation waits for it before overwriting spatial_fields
+	uint64_t last_wrap_value = 0;
+	//Most recently used first, the front entry is the one bound as surface.inital_spectrum_texture
+	std::list<CachedSpectrum> spectrum_cache;
+	VkDeviceSize spectrum_cache_budget = DEFAULT_SPECTRUM_CACHE_BUDGET;
+	std::vector<RetiredSpectrum> retired_spectra;
+	//Sea state of the updates held in the output maps, history only restarts when it changes
+	SeaStateKey active_sea_state{};
+	bool initial_spectrum_dirty = false;
+	//Rotate stored phasors by exp(i omega PHASE_STEP) each frame instead of two transcendentals per mode
+	bool incremental_phase = true;
 	bool first_check = true;
-	float last_t = -1.0f;
+	double last_t = -1.0;
 
 	struct {
 		float lastFrame;
@@ -211,17 +551,18 @@ private:
 	FFTPipelineObject fft_pipeline;
 	PipelineStateObject fft_horizontal_pso;
 	PipelineStateObject fft_vertical_pso;
+	PipelineStateObject stockham_horizontal_pso;
+	PipelineStateObject stockham_vertical_pso;
+	//Only created for resolutions up to MAX_SINGLE_WORKGROUP_FFT_RESOLUTION
+	PipelineStateObject fft_2d_pso{};
 	PipelineStateObject normal_calculation_pso;
-	PipelineStateObject initial_spectrum_pso;
-	PipelineStateObject conjugate_spectrum_pso;
+	//Variants of initial_spectrum.comp built so far, keyed by their packed specialization constants
+	std::map<uint32_t, PipelineStateObject> initial_spectrum_psos;
+	VkShaderModule initial_spectrum_shader = VK_NULL_HANDLE;
 	PipelineStateObject wrap_spectrum_pso;
 	PipelineStateObject spectrum_pso;
-	PipelineStateObject phase_pso;
+	PipelineStateObject incremental_spectrum_pso;
 	PipelineStateObject debug_pso;
-	PipelineStateObject copy_pso;
-	PipelineStateObject permute_scale_pso;
-	PipelineStateObject butterfly_pso;
-	PipelineStateObject copy_buffer_pso;
 	PipelineStateObject lookup_value_pso;
 	GPUSceneData scene_data;
 
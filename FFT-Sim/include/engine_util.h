@@ -47,8 +47,15 @@ namespace BlackKey{
 		VkCommandPool _commandPool;
 		VkCommandBuffer _mainCommandBuffer;
 
+		//Simulation recorded for the compute queue and the wrap pass that consumes it on the graphics queue
+		VkCommandPool _computeCommandPool;
+		VkCommandBuffer _computeCommandBuffer;
+		VkCommandBuffer _wrapCommandBuffer;
+
+		//Binary, acquire and present cannot wait on timeline semaphores
 		VkSemaphore _swapchainSemaphore, _renderSemaphore;
-		VkFence _renderFence;
+		//Graphics timeline value signalled by the frame's last submission, the slot is free again once it is reached
+		uint64_t _timelineValue = 0;
 
 		DeletionQueue _deletionQueue;
 		DescriptorAllocatorGrowable _frameDescriptors;
@@ -28,7 +28,8 @@ struct FrameData {
 class VulkanEngine {
 public:
 	//initializes everything in the engine
-	void init(VkPhysicalDeviceFeatures baseFeatures, VkPhysicalDeviceVulkan11Features features11, VkPhysicalDeviceVulkan12Features features12, VkPhysicalDeviceVulkan13Features features13);
+	//headless skips the window, surface and present support so only the device and queue exist
+	void init(VkPhysicalDeviceFeatures baseFeatures, VkPhysicalDeviceVulkan11Features features11, VkPhysicalDeviceVulkan12Features features12, VkPhysicalDeviceVulkan13Features features13, bool headless = false);
 
 	//shuts down the engine
 	void cleanup();
@@ -39,7 +40,7 @@ public:
 	VkDebugUtilsMessengerEXT _debug_messenger;// Vulkan debug output handle
 	VkPhysicalDevice _chosenGPU;// GPU chosen as the default device
 	VkDevice _device; // Vulkan device for commands
-	VkSurfaceKHR _surface;// Vulkan window surface
+	VkSurfaceKHR _surface{ VK_NULL_HANDLE };// Vulkan window surface
 
 	VkSwapchainKHR _swapchain;
 	VkFormat _swapchainImageFormat;
@@ -49,6 +50,7 @@ public:
 
 
 	bool _isInitialized{ false };
+	bool _headless{ false };
 
 	VkExtent2D _windowExtent{ 1920,1080 };
 	float _aspect_width = 1920;
@@ -61,17 +63,25 @@ public:
 
 	VkQueue _graphicsQueue;
 	uint32_t _graphicsQueueFamily;
+	//Queue of a family without graphics support when the device has one, the graphics queue otherwise
+	VkQueue _computeQueue;
+	uint32_t _computeQueueFamily;
+	bool _asyncComputeAvailable{ false };
 	VmaAllocator _allocator;
 	
 	VkFence _immFence;
 	VkCommandBuffer _immCommandBuffer;
 	VkCommandPool _immCommandPool;
+	VkCommandBuffer _immComputeCommandBuffer;
+	VkCommandPool _immComputeCommandPool;
 
 	DeletionQueue _mainDeletionQueue;
 	VkSampleCountFlagBits msaa_samples;
 
 	
 	void immediate_submit(std::function<void(VkCommandBuffer cmd)>&& function);
+	//Same on the compute queue, e.g. to acquire resources released by the graphics queue
+	void immediate_submit_compute(std::function<void(VkCommandBuffer cmd)>&& function);
 	//r
 	void init_vulkan(VkPhysicalDeviceFeatures baseFeatures, VkPhysicalDeviceVulkan11Features features11, VkPhysicalDeviceVulkan12Features features12, VkPhysicalDeviceVulkan13Features features13);
 	VkSampleCountFlagBits GetMSAASampleCount();
@@ -296,6 +296,8 @@ struct EngineStats {
     float ui_draw_time;
     float update_time;
     float shadow_pass_time;
+    //Time the CPU spent blocked on the GPU during the last frame
+    float cpu_wait_time;
 };
 #define VK_CHECK(x)                                                     \
     do {                                                                \
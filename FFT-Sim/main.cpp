@@ -2,15 +2,153 @@
 #include "include/Renderers/fft_renderer.h"
 #include <memory>
 #include <iostream>
+#include <string>
+#include <cstdlib>
+#include <cmath>
+#include <vector>
 #include "sim_utils.h"
+#include "storage_precision.h"
+#include "cpu_ocean.h"
 using namespace std;
 
 
+//--headless runs the GPU simulation without a window, e.g. on a CI machine with lavapipe
+int RunHeadless(VulkanEngine* engine, FFTRenderer* simulation)
+{
+	simulation->InitHeadless(engine);
+
+	//Fails the run, and the ctest entry, if a pass produced NaN or inf
+	int status = 0;
+	for (double t = 0.0; t < 1.0; t += 0.25)
+	{
+		simulation->Simulate(t);
+		const double height = getHeight(0.3, 12, t, simulation);
+		std::cout << "t = " << t << " height at (0.3, 12) = " << height << std::endl;
+		if (!std::isfinite(height))
+			status = 1;
+	}
+
+	simulation->Cleanup();
+	return status;
+}
+
+//--precision-report simulates the same sea state with FP32 and FP16 storage and prints the displacement error
+int RunPrecisionReport(uint32_t resolution)
+{
+	const double t = 5.0;
+	std::vector<float> maps[2];
+	for (int half = 0; half < 2; half++)
+	{
+		VulkanEngine engine;
+		FFTRenderer simulation;
+		simulation.SetResolution(resolution);
+		simulation.SetHalfPrecision(half == 1);
+		simulation.InitHeadless(&engine);
+		simulation.Simulate(t);
+		simulation.ReadDisplacementMap(maps[half]);
+		simulation.Cleanup();
+	}
+
+	std::cout << "FP16 storage vs FP32 displacement map at t = " << t << ", " << resolution << " x " << resolution << ":" << std::endl;
+	PrintDisplacementError(std::cout, CompareDisplacementMaps(maps[0].data(), maps[1].data(), size_t(resolution) * resolution));
+	return 0;
+}
+
+//--cpu-parity simulates the configured sea state on the GPU and with CPUOceanSimulator and fails if the
+//displacement maps differ by more than float rounding, or FP16 rounding with --fp16
+int RunCPUParity(VulkanEngine* engine, FFTRenderer* simulation)
+{
+	const double t = 5.0;
+	std::vector<float> gpu_map;
+	simulation->InitHeadless(engine);
+	simulation->Simulate(t);
+	simulation->ReadDisplacementMap(gpu_map);
+	const OceanParams params = simulation->ReferenceParams();
+	simulation->Cleanup();
+
+	CPUOceanSimulator reference(params);
+	reference.Simulate(t);
+	const DisplacementError error = CompareDisplacementMaps(reference.DisplacementMap().data(), gpu_map.data(), size_t(params.resolution) * params.resolution);
+	std::cout << "GPU vs CPU reference displacement map at t = " << t << ", " << params.resolution << " x " << params.resolution << ":" << std::endl;
+	PrintDisplacementError(std::cout, error);
+
+	const double tolerance = params.half_precision_storage ? 1e-2 : 1e-3;
+	int status = 0;
+	for (int channel = 0; channel < 3; channel++)
+	{
+		if (!(error.rms[channel] <= tolerance * error.reference_rms[channel]))
+			status = 1;
+	}
+	return status;
+}
+
 int main(int argc, char* argv[])
 {
 	auto engine = std::make_shared<VulkanEngine>();
 
 	auto FFTOceanSimulation = std::make_unique<FFTRenderer>();
+
+	//--resolution N picks the FFT grid size, a power of two from 64 to 4096. --fp16 stores the fields as half floats
+	//--seed S keys the spectrum noise, runs with the same seed are bit identical
+	//--spectrum-cache-mb M bounds the VRAM kept for initial spectra of recent sea states
+	//--spectrum phillips|pm|jonswap, --spreading cos2|donelan and --no-tma pick the initial spectrum variant
+	//--cascades N simulates N patches of decreasing size, 1 to 4. --cascade-period C P updates cascade C every P steps
+	//--sim-rate HZ simulates at a fixed rate and interpolates the frames in between
+	//--async-compute runs the spectrum and IFFT passes on a separate compute queue when the device has one
+	//--frames-in-flight N lets the CPU record up to N frames ahead of the GPU, 1 to 4
+	bool headless = false;
+	SpectrumModel spectrum_model = SpectrumModel::JONSWAP;
+	DirectionalSpreading spreading = DirectionalSpreading::DonelanSwell;
+	bool tma_depth = true;
+	bool precision_report = false;
+	bool cpu_parity = false;
+	for (int i = 1; i < argc; i++)
+	{
+		if (std::string(argv[i]) == "--headless")
+			headless = true;
+		else if (std::string(argv[i]) == "--resolution" && i + 1 < argc)
+			FFTOceanSimulation->SetResolution(uint32_t(std::strtoul(argv[++i], nullptr, 10)));
+		else if (std::string(argv[i]) == "--cascades" && i + 1 < argc)
+			FFTOceanSimulation->SetCascadeCount(uint32_t(std::strtoul(argv[++i], nullptr, 10)));
+		else if (std::string(argv[i]) == "--cascade-period" && i + 2 < argc)
+		{
+			uint32_t cascade = uint32_t(std::strtoul(argv[++i], nullptr, 10));
+			FFTOceanSimulation->SetCascadeUpdatePeriod(cascade, uint32_t(std::strtoul(argv[++i], nullptr, 10)));
+		}
+		else if (std::string(argv[i]) == "--sim-rate" && i + 1 < argc)
+			FFTOceanSimulation->SetSimulationRate(std::strtof(argv[++i], nullptr));
+		else if (std::string(argv[i]) == "--async-compute")
+			FFTOceanSimulation->SetAsyncCompute(true);
+		else if (std::string(argv[i]) == "--frames-in-flight" && i + 1 < argc)
+			FFTOceanSimulation->SetFramesInFlight(uint32_t(std::strtoul(argv[++i], nullptr, 10)));
+		else if (std::string(argv[i]) == "--fp16")
+			FFTOceanSimulation->SetHalfPrecision(true);
+		else if (std::string(argv[i]) == "--seed" && i + 1 < argc)
+			FFTOceanSimulation->SetSeed(std::strtoull(argv[++i], nullptr, 10));
+		else if (std::string(argv[i]) == "--spectrum-cache-mb" && i + 1 < argc)
+			FFTOceanSimulation->SetSpectrumCacheBudget(VkDeviceSize(std::strtoull(argv[++i], nullptr, 10)) * 1024 * 1024);
+		else if (std::string(argv[i]) == "--spectrum" && i + 1 < argc)
+		{
+			std::string model = argv[++i];
+			spectrum_model = model == "phillips" ? SpectrumModel::Phillips : model == "pm" ? SpectrumModel::PiersonMoskowitz : SpectrumModel::JONSWAP;
+		}
+		else if (std::string(argv[i]) == "--spreading" && i + 1 < argc)
+			spreading = std::string(argv[++i]) == "cos2" ? DirectionalSpreading::CosineSquared : DirectionalSpreading::DonelanSwell;
+		else if (std::string(argv[i]) == "--no-tma")
+			tma_depth = false;
+		else if (std::string(argv[i]) == "--precision-report")
+			precision_report = true;
+		else if (std::string(argv[i]) == "--cpu-parity")
+			cpu_parity = true;
+	}
+	FFTOceanSimulation->SetSpectrumModel(spectrum_model, spreading, tma_depth);
+	if (precision_report)
+		return RunPrecisionReport(FFTOceanSimulation->Resolution());
+	if (cpu_parity)
+		return RunCPUParity(engine.get(), FFTOceanSimulation.get());
+	if (headless)
+		return RunHeadless(engine.get(), FFTOceanSimulation.get());
+
 	FFTOceanSimulation->Init(engine.get());
 	float x = 0.13;
 	float y = 12;
@@ -130,11 +130,13 @@ void FFTPipelineObject::build_pipelines(VulkanEngine* engine, PipelineCreationIn
 	VkShaderModule oceanVertexShader;
 	if (!vkutil::load_shader_module(std::string(assets_path + "/shaders/ocean.vert.spv").c_str(), engine->_device, &oceanVertexShader)) {
 		std::cout << ("Error when building the shadow vertex shader module\n");
+		abort();
 	}
 
 	VkShaderModule oceanFragmentShader;
 	if (!vkutil::load_shader_module(std::string(assets_path + "/shaders/ocean.frag.spv").c_str(), engine->_device, &oceanFragmentShader)) {
 		std::cout << ("Error when building the shadow fragment shader module\n");
+		abort();
 	}
 
 
@@ -38,21 +38,25 @@ VulkanEngine* loadedEngine = nullptr;
 
 
 VulkanEngine& VulkanEngine::Get() { return *loadedEngine; }
-void VulkanEngine::init(VkPhysicalDeviceFeatures baseFeatures, VkPhysicalDeviceVulkan11Features features11, VkPhysicalDeviceVulkan12Features features12, VkPhysicalDeviceVulkan13Features features13)
+void VulkanEngine::init(VkPhysicalDeviceFeatures baseFeatures, VkPhysicalDeviceVulkan11Features features11, VkPhysicalDeviceVulkan12Features features12, VkPhysicalDeviceVulkan13Features features13, bool headless)
 {
 
 	assert(loadedEngine == nullptr);
 	loadedEngine = this;
+	_headless = headless;
 
-	glfwInit();
-	glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-	glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
-
-	window = glfwCreateWindow(_windowExtent.width, _windowExtent.height, "Black key", nullptr, nullptr);
-	if (window == nullptr)
+	if (!_headless)
 	{
-		std::cout << "Fatal error, Please exit" << std::endl;
-		abort();
+		glfwInit();
+		glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+		glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
+
+		window = glfwCreateWindow(_windowExtent.width, _windowExtent.height, "Black key", nullptr, nullptr);
+		if (window == nullptr)
+		{
+			std::cout << "Fatal error, Please exit" << std::endl;
+			abort();
+		}
 	}
 
 	init_vulkan(baseFeatures, features11, features12, features13);
@@ -78,6 +82,12 @@ void VulkanEngine::init_commands()
 	VK_CHECK(vkAllocateCommandBuffers(_device, &cmdAllocInfo, &_immCommandBuffer));
 
 	_mainDeletionQueue.push_function([=]() { vkDestroyCommandPool(_device, _immCommandPool, nullptr); });
+
+	VkCommandPoolCreateInfo computePoolInfo = vkinit::command_pool_create_info(_computeQueueFamily, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
+	VK_CHECK(vkCreateCommandPool(_device, &computePoolInfo, nullptr, &_immComputeCommandPool));
+
+	VkCommandBufferAllocateInfo computeAllocInfo = vkinit::command_buffer_allocate_info(_immComputeCommandPool, 1);
+	VK_CHECK(vkAllocateCommandBuffers(_device, &computeAllocInfo, &_immComputeCommandBuffer));
 }
 void VulkanEngine::init_imgui()
 {
@@ -173,6 +183,7 @@ void VulkanEngine::cleanup()
 
 		vkFreeCommandBuffers(_device, _immCommandPool, 1, &_immCommandBuffer);
 		vkDestroyCommandPool(_device, _immCommandPool,nullptr);
+		vkDestroyCommandPool(_device, _immComputeCommandPool, nullptr);
 		vkDestroyFence(_device, _immFence, nullptr);
 		vkDestroySurfaceKHR(_instance, _surface, nullptr);
 		vmaDestroyAllocator(_allocator);
@@ -181,11 +192,17 @@ void VulkanEngine::cleanup()
 		vkb::destroy_debug_utils_messenger(_instance, _debug_messenger);
 		vkDestroyInstance(_instance, nullptr);
 
+		_isInitialized = false;
+	}
+	if (window != nullptr)
+	{
+		glfwDestroyWindow(window);
+		window = nullptr;
 	}
-	glfwDestroyWindow(window);
 	// clear engine pointer
 	loadedEngine = nullptr;
-	glfwTerminate();
+	if (!_headless)
+		glfwTerminate();
 }
 
 void VulkanEngine::init_sync_structures()
@@ -223,6 +240,29 @@ void VulkanEngine::immediate_submit(std::function<void(VkCommandBuffer cmd)>&& f
 	VK_CHECK(vkWaitForFences(_device, 1, &_immFence, true, 9999999999));
 }
 
+void VulkanEngine::immediate_submit_compute(std::function<void(VkCommandBuffer cmd)>&& function)
+{
+	VK_CHECK(vkResetFences(_device, 1, &_immFence));
+	VK_CHECK(vkResetCommandBuffer(_immComputeCommandBuffer, 0));
+
+	VkCommandBuffer cmd = _immComputeCommandBuffer;
+
+	VkCommandBufferBeginInfo cmdBeginInfo = vkinit::command_buffer_begin_info(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+
+	VK_CHECK(vkBeginCommandBuffer(cmd, &cmdBeginInfo));
+
+	function(cmd);
+
+	VK_CHECK(vkEndCommandBuffer(cmd));
+
+	VkCommandBufferSubmitInfo cmdinfo = vkinit::command_buffer_submit_info(cmd);
+	VkSubmitInfo2 submit = vkinit::submit_info(&cmdinfo, nullptr, nullptr);
+
+	VK_CHECK(vkQueueSubmit2(_computeQueue, 1, &submit, _immFence));
+
+	VK_CHECK(vkWaitForFences(_device, 1, &_immFence, true, 9999999999));
+}
+
 
 
 void VulkanEngine::init_vulkan(VkPhysicalDeviceFeatures baseFeatures, VkPhysicalDeviceVulkan11Features features11, VkPhysicalDeviceVulkan12Features features12, VkPhysicalDeviceVulkan13Features features13)
@@ -242,6 +282,7 @@ void VulkanEngine::init_vulkan(VkPhysicalDeviceFeatures baseFeatures, VkPhysical
 		.use_default_debug_messenger()
 		.require_api_version(1, 3, 0)
 		.enable_extension("VK_KHR_get_physical_device_properties2")
+		.set_headless(_headless)
 		.build();
 
 	vkb::Instance vkb_inst = inst_ret.value();
@@ -254,21 +295,29 @@ void VulkanEngine::init_vulkan(VkPhysicalDeviceFeatures baseFeatures, VkPhysical
 	//< init_instance
 	// 
 	//> init_device
-	glfwCreateWindowSurface(_instance, window, nullptr, &_surface);
+	if (!_headless)
+		glfwCreateWindowSurface(_instance, window, nullptr, &_surface);
 
 
 	//use vkbootstrap to select a gpu. 
 	//We want a gpu that can write to the glfw surface and supports vulkan 1.3 with the correct features
+	//Headless instances have no surface, any device with the features qualifies, software ICDs included
 	vkb::PhysicalDeviceSelector selector{ vkb_inst };
-	vkb::PhysicalDevice physicalDevice = selector
-		.set_minimum_version(1, 3)
+	selector.set_minimum_version(1, 3)
 		.set_required_features(baseFeatures)
 		.set_required_features_13(features13)
 		.set_required_features_12(features12)
-		.set_required_features_11(features11)
-		.set_surface(_surface)
-		.select()
-		.value();
+		.set_required_features_11(features11);
+	if (!_headless)
+		selector.set_surface(_surface);
+
+	auto physical_device_ret = selector.select();
+	if (!physical_device_ret)
+	{
+		std::cout << "No suitable Vulkan device: " << physical_device_ret.error().message() << std::endl;
+		abort();
+	}
+	vkb::PhysicalDevice physicalDevice = physical_device_ret.value();
 
 
 	msaa_samples = vkinit::getMaxAvailableSampleCount(physicalDevice.properties);
@@ -287,9 +336,24 @@ void VulkanEngine::init_vulkan(VkPhysicalDeviceFeatures baseFeatures, VkPhysical
 
 	//> init_queue
 		// use vkbootstrap to get a Graphics queue
+		// graphics families always support compute, headless mode runs its FFT passes on it as well
 	_graphicsQueue = vkbDevice.get_queue(vkb::QueueType::graphics).value();
 	_graphicsQueueFamily = vkbDevice.get_queue_index(vkb::QueueType::graphics).value();
 
+	//vk-bootstrap creates one queue per family, compute only picks a family other than the graphics one
+	auto compute_queue = vkbDevice.get_queue(vkb::QueueType::compute);
+	if (compute_queue.has_value())
+	{
+		_computeQueue = compute_queue.value();
+		_computeQueueFamily = vkbDevice.get_queue_index(vkb::QueueType::compute).value();
+		_asyncComputeAvailable = true;
+	}
+	else
+	{
+		_computeQueue = _graphicsQueue;
+		_computeQueueFamily = _graphicsQueueFamily;
+	}
+
 	VmaAllocatorCreateInfo allocatorInfo = {};
 	allocatorInfo.physicalDevice = _chosenGPU;
 	allocatorInfo.device = _device;
@@ -3,13 +3,19 @@ C:\VulkanSDK\1.4.321.1\Bin\glslc.exe fft_horizontal.comp -o fft_horizontal.spv
 C:\VulkanSDK\1.4.321.1\Bin\glslc.exe ocean.vert -o ocean.vert.spv
 C:\VulkanSDK\1.4.321.1\Bin\glslc.exe ocean.frag -o ocean.frag.spv
 C:\VulkanSDK\1.4.321.1\Bin\glslc.exe debug.comp -o debug.spv
-C:\VulkanSDK\1.4.321.1\Bin\glslc.exe jonswap_spectrum.comp -o jonswap_spectrum.spv
+C:\VulkanSDK\1.4.321.1\Bin\glslc.exe initial_spectrum.comp -o initial_spectrum.spv
 C:\VulkanSDK\1.4.321.1\Bin\glslc.exe time_dependent_spectrum.comp -o time_dependent_spectrum.spv
-C:\VulkanSDK\1.4.321.1\Bin\glslc.exe conjugate_spectrum.comp -o conjugate_spectrum.spv
-C:\VulkanSDK\1.4.321.1\Bin\glslc.exe copy.comp -o copy.spv
-C:\VulkanSDK\1.4.321.1\Bin\glslc.exe copy_height_buffer.comp -o copy_height_buffer.spv
 C:\VulkanSDK\1.4.321.1\Bin\glslc.exe get_value.comp -o get_value.spv
-C:\VulkanSDK\1.4.321.1\Bin\glslc.exe permute_and_scale.comp -o permute_and_scale.spv
-C:\VulkanSDK\1.4.321.1\Bin\glslc.exe butterfly.comp -o butterfly.spv
+C:\VulkanSDK\1.4.321.1\Bin\glslc.exe normal_map.comp -o normal_map.spv
 C:\VulkanSDK\1.4.321.1\Bin\glslc.exe spectrum_wrapper.comp -o spectrum_wrapper.spv
+C:\VulkanSDK\1.4.321.1\Bin\glslc.exe fft_stockham.comp -o fft_stockham.spv
+C:\VulkanSDK\1.4.321.1\Bin\glslc.exe -DHALF_STORAGE time_dependent_spectrum.comp -o time_dependent_spectrum_fp16.spv
+C:\VulkanSDK\1.4.321.1\Bin\glslc.exe -DHALF_STORAGE fft_horizontal.comp -o fft_horizontal_fp16.spv
+C:\VulkanSDK\1.4.321.1\Bin\glslc.exe -DHALF_STORAGE fft_vertical.comp -o fft_vertical_fp16.spv
+C:\VulkanSDK\1.4.321.1\Bin\glslc.exe -DHALF_STORAGE fft_stockham.comp -o fft_stockham_fp16.spv
+C:\VulkanSDK\1.4.321.1\Bin\glslc.exe -DHALF_STORAGE spectrum_wrapper.comp -o spectrum_wrapper_fp16.spv
+C:\VulkanSDK\1.4.321.1\Bin\glslc.exe --target-env=vulkan1.3 fft_subgroup.comp -o fft_subgroup.spv
+C:\VulkanSDK\1.4.321.1\Bin\glslc.exe --target-env=vulkan1.3 -DHALF_STORAGE fft_subgroup.comp -o fft_subgroup_fp16.spv
+C:\VulkanSDK\1.4.321.1\Bin\glslc.exe fft_2d.comp -o fft_2d.spv
+C:\VulkanSDK\1.4.321.1\Bin\glslc.exe -DHALF_STORAGE fft_2d.comp -o fft_2d_fp16.spv
 pause
\ No newline at end of file
@@ -0,0 +1,36 @@
+//Push constants of every FFTParams pass, member for member the FFTParams struct of fft_renderer.h.
+//Shaders include this instead of keeping their own copy, new members go at the end of both
+layout( push_constant ) uniform constants
+{
+	int resolution;
+	int ocean_size;
+	vec2 wind; //x-speed y-angle
+	float delta_time;
+	float choppiness;
+	int total_count;
+	int log_size;
+	float fetch;
+	float swell;
+	float depth;
+	int stage;
+	int ping_pong_count;
+	float displacement_factor;
+	float foam_intensity;
+	float foam_decay;
+	//64 bit noise seed, FFTRenderer::SetSeed
+	uint seed_low;
+	uint seed_high;
+	//Absolute time as a float pair, time_high + time_low holds the double of the host
+	float time_high;
+	float time_low;
+	int step_count;
+	int phase_flags;
+	//World size of each cascade's patch, MAX_CASCADES entries of which cascade_count are used
+	float cascade_sizes[4];
+	int cascade_count;
+	//Cascade and IFFT slot of workgroup z = 0, a dispatch covers consecutive cascades due on the same frame
+	int cascade_base;
+	int slot_base;
+	//Update layer the wrap pass writes, layer 2 * cascade + key_layer of the output maps
+	int key_layer;
+} PushConstants;
@@ -1,4 +1,5 @@
 #version 460 core
+#extension GL_GOOGLE_include_directive : require
 
 layout (location = 0) in vec3 inFragPos;
 layout (location = 1) in vec2 inUV;
@@ -9,26 +10,10 @@ layout (location = 0) out vec4 outFragColor;
 
 const float PI = 3.14159265359;
 
-layout (set = 0, binding = 1) uniform sampler2D normal_map;
-
-layout(set = 0, binding = 2) uniform  SceneData{   
-    vec3 world_camera_pos;
-    int show_wireframe;
-    vec3 sun_direction;    
-    int padding;
-    vec4 sun_color;
-    vec4 diffuse_reflectance;
-    float fresnel_normal_strength;
-    float fresnel_shininess;
-    float fresnel_bias;
-    float specular_reflectance;
-    float specular_normal_strength;
-    float shininess;
-    float fresnel_strength;
-    float foam;
-    vec4 ambient;
-    vec4 fresnel_color;
-} sceneData;
+//Slopes, laid out like the displacement map of ocean.vert
+layout (set = 0, binding = 1) uniform sampler2DArray normal_map;
+
+#include "ocean_scene.glsl"
 
 layout(set=0,binding=3) uniform samplerCube environmentMap;
 
@@ -54,7 +39,10 @@ float saturate(float a)
 void main()
 {
      
-    vec3 normal = texture(normal_map, inUV).xyz;
+    //Slopes of the cascades add up like their heights
+    vec3 normal = vec3(0.0f);
+    for (int cascade = 0; cascade < sceneData.cascade_count; cascade++)
+        normal += SampleCascade(normal_map, inUV, cascade).xyz;
     normal *= sceneData.fresnel_normal_strength;
     normal = normalize(vec3(-normal.x,1.0f,-normal.y));
 	vec3 view_dir = normalize(inFragPos - sceneData.world_camera_pos);
@@ -8,7 +8,10 @@ layout (location = 1) out vec2 outUV;
 layout (location = 2) out vec3 outNormal;
 
 
-layout (set = 0, binding = 0) uniform sampler2D displacement_map;
+//Displacement of every cascade, its last two updates each
+layout (set = 0, binding = 0) uniform sampler2DArray displacement_map;
+
+#include "ocean_scene.glsl"
 
 struct Vertex{
 	vec4 position;
@@ -29,14 +32,23 @@ layout( push_constant ) uniform constants
 } PushConstants;
 
 
+vec4 SumDisplacement(vec2 uv)
+{
+	vec4 displacement = vec4(0.0f);
+	for (int cascade = 0; cascade < sceneData.cascade_count; cascade++)
+		displacement += SampleCascade(displacement_map, uv, cascade);
+	return displacement;
+}
+
 vec3 CalcSlopeNormal(vec2 texCoord)
 {   
-	float textureDelta = 1/512.0;
+	//One texel of the first cascade, whatever resolution the simulation runs at
+	float textureDelta = 1.0 / float(textureSize(displacement_map, 0).x);
 	
-	float left = texture(displacement_map, texCoord + vec2(-textureDelta,0)).r;
-	float right = texture(displacement_map, texCoord + vec2(textureDelta,0)).r;
-	float up = texture(displacement_map, texCoord + vec2(0,textureDelta)).r;
-	float down = texture(displacement_map, texCoord + vec2(0,-textureDelta)).r;
+	float left = SumDisplacement(texCoord + vec2(-textureDelta,0)).r;
+	float right = SumDisplacement(texCoord + vec2(textureDelta,0)).r;
+	float up = SumDisplacement(texCoord + vec2(0,textureDelta)).r;
+	float down = SumDisplacement(texCoord + vec2(0,-textureDelta)).r;
 	
 	vec3 normal = normalize(vec3(left - right,1.0f, up - down));
 	return normalize(normal);
@@ -45,7 +57,7 @@ vec3 CalcSlopeNormal(vec2 texCoord)
 void main()
 {
 	Vertex v = PushConstants.vertexBuffer.vertices[gl_VertexIndex];
-	vec4 disp = texture(displacement_map, v.uv).rgba;
+	vec4 disp = SumDisplacement(v.uv);
 	//disp = disp / PushConstants.ocean_size;
 	vec3 position = v.position.xyz;/* + texture(displacement_map, v.uv).rgb;*/
 	
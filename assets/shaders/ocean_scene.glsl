@@ -0,0 +1,44 @@
+//OceanUBO of fft_renderer.h, shared by ocean.vert and ocean.frag
+layout(set = 0, binding = 2) uniform  SceneData{   
+    vec3 world_camera_pos;
+    int show_wireframe;
+    vec3 sun_direction;    
+    int padding;
+    vec4 sun_color;
+    vec4 diffuse_reflectance;
+    float fresnel_normal_strength;
+    float fresnel_shininess;
+    float fresnel_bias;
+    float specular_reflectance;
+    float specular_normal_strength;
+    float shininess;
+    float fresnel_strength;
+    float foam;
+    vec4 ambient;
+    vec4 fresnel_color;
+    //Patch size of every cascade in world units, layer c of the maps tiles the plane every cascade_sizes[c]
+    vec4 cascade_sizes;
+    //How far rendering is from the previous update of a cascade towards its newest, and the layer of the newest
+    vec4 cascade_blend;
+    ivec4 cascade_newest_key;
+    int cascade_count;
+} sceneData;
+
+//The mesh UV covers the first cascade once, finer ones repeat across it
+vec2 CascadeUV(vec2 uv, int cascade)
+{
+    return (uv - 0.5) * (sceneData.cascade_sizes[0] / sceneData.cascade_sizes[cascade]) + 0.5;
+}
+
+//Value of one cascade at the frame time. Cascades updated less than every frame are simulated ahead
+//and blended from their previous update, the two sit in layers 2c and 2c + 1
+vec4 SampleCascade(sampler2DArray map, vec2 uv, int cascade)
+{
+    vec2 cascade_uv = CascadeUV(uv, cascade);
+    int newest = 2 * cascade + sceneData.cascade_newest_key[cascade];
+    vec4 value = texture(map, vec3(cascade_uv, newest));
+    float blend = sceneData.cascade_blend[cascade];
+    if (blend < 1.0)
+        value = mix(texture(map, vec3(cascade_uv, newest ^ 1)), value, blend);
+    return value;
+}
@@ -1,22 +1,39 @@
 #include <iostream>
 #include "sim_utils.h"
+#include "cpu_ocean.h"
+#include "storage_precision.h"
 
 
 int main(int argc, char const *argv[])
 {
+    // Headless CPU ocean, no window or GPU needed
+    OceanParams params;
+    params.seed = 1;
+    CPUOceanSimulator ocean(params);
+
     // Create FEM elements
     Eigen::MatrixXd elementVertices = createFEMElements();
 
     // Get height at each element vertex at given sim time
     const double simTime = 5.0;     // arbitarily chosen
-    Eigen::VectorXd waveHeights = calculateWaveHeights(elementVertices, simTime);
+    Eigen::VectorXd waveHeights = calculateWaveHeights(elementVertices, simTime, &ocean);
 
     // Print wave heights
-    std::cout << "Wave heights at t = " << simTime << ":" << std::endl;
+    std::cout << "Wave heights at t = " << simTime << " (" << OceanFFT::SimdName() << ", " << ocean.ThreadCount() << " threads):" << std::endl;
     for (unsigned int itr = 0; itr < elementVertices.cols(); itr ++)
     {
         const Eigen::Vector3d vertex = elementVertices.col(itr);
         std::cout << "Point: (" <<  vertex.x() << "," << vertex.y() << "," << vertex.z() << ")\tHeight: " << waveHeights[itr] << std::endl;
     }
+
+    // Error of the FP16 storage mode against the FP32 surface at the same time
+    OceanParams halfParams = params;
+    halfParams.half_precision_storage = true;
+    CPUOceanSimulator halfOcean(halfParams);
+    ocean.Simulate(simTime);
+    halfOcean.Simulate(simTime);
+    std::cout << "FP16 storage vs FP32 displacement map at t = " << simTime << ":" << std::endl;
+    PrintDisplacementError(std::cout, CompareDisplacementMaps(ocean.DisplacementMap().data(), halfOcean.DisplacementMap().data(),
+        size_t(params.resolution) * size_t(params.resolution)));
     return 0;
 }
@@ -0,0 +1,59 @@
+#pragma once
+#include "ocean_query.h"
+#include "ocean_spectrum.h"
+#include "ocean_fft.h"
+#include "thread_pool.h"
+
+#include <thread>
+#include <vector>
+
+//Headless CPU reference of the FFTRenderer simulation: same spectrum, time evolution,
+//IFFT and displacement packing, with no window or Vulkan device.
+class CPUOceanSimulator : public OceanHeightQuery {
+public:
+	explicit CPUOceanSimulator(const OceanParams& params = OceanParams(), unsigned int thread_count = std::thread::hardware_concurrency());
+
+	//Regenerates the initial spectrum for a new sea state
+	void SetParams(const OceanParams& params);
+	const OceanParams& Params() const { return params; }
+
+	//Evaluates the surface at time t into the displacement and height derivative maps
+	void Simulate(double t);
+
+	//Bilinear, clamp to edge lookup of the height, like get_value.comp
+	void GetHeights(const OceanPoint* points, size_t count, double t, float* out) override;
+
+	//RGBA per texel: (choppy x, height, choppy z, 1), same layout as the displacement_map image
+	const std::vector<float>& DisplacementMap() const { return displacement_map; }
+	//RG per texel: surface slopes along x and z
+	const std::vector<float>& HeightDerivative() const { return height_derivative; }
+	unsigned int ThreadCount() const { return pool.ThreadCount(); }
+
+private:
+	//Real fields are transformed in pairs as A + iB, the real and imaginary parts of the result hold A and B
+	enum Signal {
+		SIGNAL_HEIGHT_DISPLACEMENT_X,
+		SIGNAL_DISPLACEMENT_Z_TANGENT,
+		SIGNAL_BITANGENT,
+		SIGNAL_COUNT
+	};
+
+	void GenerateSpectrum(double time);
+	void DoIFFT();
+	void WrapSpectrum();
+	//Applies the FP16 image store rounding to the packed fields when half_precision_storage is set
+	void RoundFieldsToHalf();
+
+	OceanParams params;
+	ThreadPool pool;
+	OceanSpectrum spectrum;
+	OceanFFT fft;
+
+	std::vector<float> field_re[SIGNAL_COUNT];
+	std::vector<float> field_im[SIGNAL_COUNT];
+	std::vector<float> displacement_map;
+	std::vector<float> height_derivative;
+
+	double last_t = 0.0;
+	bool first_check = true;
+};
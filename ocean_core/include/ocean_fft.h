@@ -0,0 +1,41 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class ThreadPool;
+
+//Unnormalised inverse 2D FFT (positive exponent, same convention as the butterfly texture) on
+//split complex, row major N x N grids. Radix-4 passes run on cache sized strips of neighbouring
+//rows/columns and are vectorised across the strip with AVX2, NEON or plain scalar code.
+class OceanFFT {
+public:
+	static constexpr int STRIP = 16;
+
+	OceanFFT() = default;
+	explicit OceanFFT(int resolution);
+
+	//Transforms field_count grids in place, horizontal pass first then vertical
+	void Inverse2D(float* const* re, float* const* im, size_t field_count, ThreadPool* pool = nullptr) const;
+	//The two passes of Inverse2D, for callers that touch the grids in between
+	void InverseRows(float* const* re, float* const* im, size_t field_count, ThreadPool* pool = nullptr) const;
+	void InverseColumns(float* const* re, float* const* im, size_t field_count, ThreadPool* pool = nullptr) const;
+
+	int Resolution() const { return N; }
+	static const char* SimdName();
+
+private:
+	struct Pass {
+		int span;
+		bool radix4;
+		size_t twiddle_offset;
+	};
+
+	void TransformStrip(float* re, float* im) const;
+
+	int N = 0;
+	std::vector<uint32_t> bit_reverse;
+	std::vector<Pass> passes;
+	std::vector<float> twiddle_re;
+	std::vector<float> twiddle_im;
+};
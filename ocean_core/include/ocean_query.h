@@ -0,0 +1,17 @@
+#pragma once
+#include <cstddef>
+
+//Horizontal sample position in ocean space, layout compatible with glm::vec2
+struct OceanPoint {
+	float x;
+	float y;
+};
+
+//Height lookup interface shared by the GPU renderer and the CPU reference engine
+class OceanHeightQuery {
+public:
+	virtual ~OceanHeightQuery() = default;
+
+	//Writes the surface height at each of the count points for simulation time t into out
+	virtual void GetHeights(const OceanPoint* points, size_t count, double t, float* out) = 0;
+};
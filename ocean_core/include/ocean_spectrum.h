@@ -0,0 +1,44 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+class ThreadPool;
+
+//Sea state and grid description, mirrors what the renderer pushes through FFTParams
+struct OceanParams {
+	//Same order as SpectrumModel and DirectionalSpreading of fft_renderer.h
+	enum class Spectrum { Phillips, PiersonMoskowitz, JONSWAP };
+	enum class Spreading { CosineSquared, DonelanSwell };
+
+	int resolution = 512;
+	//Side of the simulated patch in metres, independent of the resolution like the GPU path's first cascade
+	float patch_size = 512.0f;
+	float wind_speed = 5.142135f;
+	float wind_angle = 45.0f; //degrees
+	float fetch = 1000.0f * 1000.0f;
+	float swell = 0.5f;
+	float depth = 500.0f;
+	float displacement_factor = 0.9f;
+	//Key of the hashed Gaussian noise, the same seed reproduces the same sea on CPU and GPU
+	uint64_t seed = 0;
+	Spectrum spectrum = Spectrum::JONSWAP;
+	Spreading spreading = Spreading::DonelanSwell;
+	bool tma_depth = true;
+	//Rounds every stored intermediate to half, like the FP16 storage mode of the GPU path
+	bool half_precision_storage = false;
+};
+
+//Time independent wave data, generated once per sea state.
+//Matches the initial_spectrum image of the GPU path, conj(h0(-k)) is read from the mirrored texel.
+struct OceanSpectrum {
+	int resolution = 0;
+	std::vector<float> h0_re, h0_im; //h0(k)
+};
+
+//Wave vector of texel (x, y) on the centred grid, cheaper to recompute than to store like the shaders do
+void WaveVector(int resolution, float patch_size, int x, int y, float& k_x, float& k_z);
+//Deep water dispersion relation, omega = sqrt(g |k|)
+float WaveDispersion(float kLength);
+
+//Spectrum model, spreading and depth correction picked by params, the variants of initial_spectrum.comp
+void GenerateInitialSpectrum(const OceanParams& params, OceanSpectrum& spectrum, ThreadPool* pool = nullptr);
@@ -10,19 +10,18 @@
 
 #pragma once
 #include <Eigen/Dense>
-#include "Renderers/fft_renderer.h"
+#include "ocean_query.h"
 
 /**
  * @brief Compute the surface height at a given (x, y, t) location.
  *
- * Placeholder function — replace with actual implementation.
- *
  * @param[in] x X-coordinate of the point.
  * @param[in] y Y-coordinate of the point.
  * @param[in] t Simulation time.
- * @return double Height value (currently returns 0.0).
+ * @param[in] fft_simulator Ocean simulation answering the query (GPU or CPU).
+ * @return double Height value.
  */
-double getHeight(const double x, const double y, const double t, FFTRenderer* fft_simulator);
+double getHeight(const double x, const double y, const double t, OceanHeightQuery* fft_simulator);
 
 /**
  * @brief Create a finite element representation of a 1x1x1 m cube.
@@ -37,14 +36,16 @@ Eigen::MatrixXd createFEMElements();
 /**
  * @brief Calculate wave heights at the vertices of a given element.
  *
- * Iterates over each vertex of the provided element and computes the
- * corresponding wave height using the @ref getHeight function.
+ * Gathers every vertex of the provided element and evaluates all of the
+ * wave heights with a single batched OceanHeightQuery::GetHeights query,
+ * answered either by the GPU FFTRenderer or the CPU reference engine.
  *
  * @param[in] elementVertices A 3xN matrix of vertex coordinates (each column is a vertex).
  * @param[in] simTime Simulation time at which to evaluate the wave heights.
+ * @param[in] fft_simulator Ocean simulation answering the query (GPU or CPU).
  * @return Eigen::VectorXd A vector of wave heights, one for each vertex.
  */
-Eigen::VectorXd calculateWaveHeights (const Eigen::MatrixXd& elementVertices, const double simTime, FFTRenderer* fft_simulator);
+Eigen::VectorXd calculateWaveHeights (const Eigen::MatrixXd& elementVertices, const double simTime, OceanHeightQuery* fft_simulator);
 
 
 void check_sim();
\ No newline at end of file
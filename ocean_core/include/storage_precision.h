@@ -0,0 +1,21 @@
+#pragma once
+#include <cstddef>
+#include <ostream>
+
+//Rounds to the nearest IEEE half value (ties to even), i.e. what a store to an
+//R16G16B16A16_SFLOAT image keeps. Magnitudes past 65504 become infinity.
+float RoundToHalf(float value);
+
+//Error of a displacement map against a reference one, both RGBA (choppy x, height, choppy z, 1).
+//Channels are indexed x, height, z.
+struct DisplacementError {
+	size_t texel_count = 0;
+	double max_abs[3] = {};
+	double rms[3] = {};
+	double reference_rms[3] = {};
+};
+
+DisplacementError CompareDisplacementMaps(const float* reference, const float* test, size_t texel_count);
+
+//One line per channel with max/RMS error and the RMS error relative to the reference signal
+void PrintDisplacementError(std::ostream& out, const DisplacementError& error);
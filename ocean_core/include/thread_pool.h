@@ -0,0 +1,41 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//Fixed set of worker threads used to split loops of independent work items
+class ThreadPool {
+public:
+	explicit ThreadPool(unsigned int thread_count = std::thread::hardware_concurrency());
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	//Runs fn(index) for every index in [0, count) and returns once all of them have finished.
+	//The calling thread takes part in the work.
+	void ParallelFor(size_t count, const std::function<void(size_t)>& fn);
+
+	unsigned int ThreadCount() const { return unsigned(workers.size()) + 1; }
+
+private:
+	void WorkerLoop();
+	void RunItems();
+
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable job_ready;
+	std::condition_variable job_done;
+
+	const std::function<void(size_t)>* job = nullptr;
+	size_t job_count = 0;
+	std::atomic<size_t> next_item{ 0 };
+	unsigned int busy_workers = 0;
+	uint64_t generation = 0;
+	bool stopping = false;
+};
@@ -0,0 +1,193 @@
+#include "cpu_ocean.h"
+#include "storage_precision.h"
+
+#include <algorithm>
+#include <cmath>
+
+CPUOceanSimulator::CPUOceanSimulator(const OceanParams& params, unsigned int thread_count)
+	: pool(thread_count)
+{
+	SetParams(params);
+}
+
+void CPUOceanSimulator::SetParams(const OceanParams& new_params)
+{
+	params = new_params;
+	const size_t texel_count = size_t(params.resolution) * size_t(params.resolution);
+
+	//initial_spectrum stays rg32f in the FP16 mode, nothing to round
+	GenerateInitialSpectrum(params, spectrum, &pool);
+	if (fft.Resolution() != params.resolution)
+		fft = OceanFFT(params.resolution);
+
+	for (int field = 0; field < SIGNAL_COUNT; field++)
+	{
+		field_re[field].assign(texel_count, 0.0f);
+		field_im[field].assign(texel_count, 0.0f);
+	}
+	displacement_map.assign(texel_count * 4, 0.0f);
+	height_derivative.assign(texel_count * 2, 0.0f);
+	first_check = true;
+}
+
+void CPUOceanSimulator::Simulate(double t)
+{
+	if (!first_check && last_t == t)
+		return;
+
+	first_check = false;
+	last_t = t;
+
+	GenerateSpectrum(t);
+	DoIFFT();
+	WrapSpectrum();
+}
+
+//time_dependent_spectrum.comp
+void CPUOceanSimulator::GenerateSpectrum(double time)
+{
+	const int N = params.resolution;
+	pool.ParallelFor(size_t(N), [&](size_t y) {
+		for (size_t index = y * N; index < (y + 1) * N; index++)
+		{
+			//Nyquist row/column and DC are not Hermitian for the ik fields and would leak into the paired field
+			size_t x = index - y * N;
+			if (x == 0 || y == 0 || (x == size_t(N / 2) && y == size_t(N / 2)))
+			{
+				for (int signal = 0; signal < SIGNAL_COUNT; signal++)
+				{
+					field_re[signal][index] = 0.0f;
+					field_im[signal][index] = 0.0f;
+				}
+				continue;
+			}
+
+			//k and omega are recomputed rather than stored, like time_dependent_spectrum.comp
+			float k_x, k_z;
+			WaveVector(N, params.patch_size, int(x), int(y), k_x, k_z);
+			float kLength = std::sqrt(k_x * k_x + k_z * k_z);
+			float oneOverKLength = 1.0f / kLength;
+
+			//Double precision phase like the absolute time path of the shader, stays exact over long runs
+			double phase = double(WaveDispersion(kLength)) * time;
+			float c = float(std::cos(phase));
+			float s = float(std::sin(phase));
+
+			//h0 * e^(i phase) + conj(h0(-k)) * e^(-i phase), -k is the mirrored texel
+			size_t mirrored = ((N - y) % N) * N + (N - x) % N;
+			float h0r = spectrum.h0_re[index], h0i = spectrum.h0_im[index];
+			float h1r = spectrum.h0_re[mirrored], h1i = -spectrum.h0_im[mirrored];
+			float hr = (h0r * c - h0i * s) + (h1r * c + h1i * s);
+			float hi = (h0r * s + h0i * c) + (h1i * c - h1r * s);
+
+			float ihr = -hi;
+			float ihi = hr;
+
+			float dxr = oneOverKLength * k_x * ihr, dxi = oneOverKLength * k_x * ihi;
+			float dzr = oneOverKLength * k_z * ihr, dzi = oneOverKLength * k_z * ihi;
+			float tr = ihr * k_x, ti = ihi * k_x;
+
+			//A + iB = (Ar - Bi) + i(Ai + Br)
+			field_re[SIGNAL_HEIGHT_DISPLACEMENT_X][index] = hr - dxi;
+			field_im[SIGNAL_HEIGHT_DISPLACEMENT_X][index] = hi + dxr;
+			field_re[SIGNAL_DISPLACEMENT_Z_TANGENT][index] = dzr - ti;
+			field_im[SIGNAL_DISPLACEMENT_Z_TANGENT][index] = dzi + tr;
+			field_re[SIGNAL_BITANGENT][index] = ihr * k_z;
+			field_im[SIGNAL_BITANGENT][index] = ihi * k_z;
+		}
+	});
+}
+
+void CPUOceanSimulator::DoIFFT()
+{
+	float* re[SIGNAL_COUNT];
+	float* im[SIGNAL_COUNT];
+	for (int field = 0; field < SIGNAL_COUNT; field++)
+	{
+		re[field] = field_re[field].data();
+		im[field] = field_im[field].data();
+	}
+	//spectrum_fields, then ping_1 between the horizontal and vertical passes, then spatial_fields
+	RoundFieldsToHalf();
+	fft.InverseRows(re, im, SIGNAL_COUNT, &pool);
+	RoundFieldsToHalf();
+	fft.InverseColumns(re, im, SIGNAL_COUNT, &pool);
+	RoundFieldsToHalf();
+}
+
+void CPUOceanSimulator::RoundFieldsToHalf()
+{
+	if (!params.half_precision_storage)
+		return;
+
+	const size_t N = size_t(params.resolution);
+	pool.ParallelFor(N, [&](size_t y) {
+		for (int signal = 0; signal < SIGNAL_COUNT; signal++)
+		{
+			for (size_t index = y * N; index < (y + 1) * N; index++)
+			{
+				field_re[signal][index] = RoundToHalf(field_re[signal][index]);
+				field_im[signal][index] = RoundToHalf(field_im[signal][index]);
+			}
+		}
+	});
+}
+
+//Sign permutation of the last FFT stage followed by spectrum_wrapper.comp
+void CPUOceanSimulator::WrapSpectrum()
+{
+	const int N = params.resolution;
+	const float lambda = params.displacement_factor;
+	pool.ParallelFor(size_t(N), [&](size_t y) {
+		for (size_t x = 0; x < size_t(N); x++)
+		{
+			size_t index = y * N + x;
+			float perm = (x + y) % 2 == 0 ? -1.0f : 1.0f;
+
+			displacement_map[index * 4 + 0] = lambda * perm * field_im[SIGNAL_HEIGHT_DISPLACEMENT_X][index];
+			displacement_map[index * 4 + 1] = perm * field_re[SIGNAL_HEIGHT_DISPLACEMENT_X][index];
+			displacement_map[index * 4 + 2] = lambda * perm * field_re[SIGNAL_DISPLACEMENT_Z_TANGENT][index];
+			displacement_map[index * 4 + 3] = 1.0f;
+
+			height_derivative[index * 2 + 0] = perm * field_im[SIGNAL_DISPLACEMENT_Z_TANGENT][index];
+			height_derivative[index * 2 + 1] = perm * field_re[SIGNAL_BITANGENT][index];
+
+			if (params.half_precision_storage)
+			{
+				for (int c = 0; c < 3; c++)
+					displacement_map[index * 4 + c] = RoundToHalf(displacement_map[index * 4 + c]);
+				for (int c = 0; c < 2; c++)
+					height_derivative[index * 2 + c] = RoundToHalf(height_derivative[index * 2 + c]);
+			}
+		}
+	});
+}
+
+void CPUOceanSimulator::GetHeights(const OceanPoint* points, size_t count, double t, float* out)
+{
+	Simulate(t);
+
+	const int N = params.resolution;
+	auto height_at = [&](int x, int y) {
+		x = std::clamp(x, 0, N - 1);
+		y = std::clamp(y, 0, N - 1);
+		return displacement_map[(size_t(y) * N + x) * 4 + 1];
+	};
+
+	for (size_t i = 0; i < count; i++)
+	{
+		//uv = p / patch_size + 0.5, then texel space with centres at +0.5
+		float u = (points[i].x / params.patch_size + 0.5f) * float(N) - 0.5f;
+		float v = (points[i].y / params.patch_size + 0.5f) * float(N) - 0.5f;
+		float x0 = std::floor(u);
+		float y0 = std::floor(v);
+		float fx = u - x0;
+		float fy = v - y0;
+		int ix = int(x0);
+		int iy = int(y0);
+
+		float top = height_at(ix, iy) * (1.0f - fx) + height_at(ix + 1, iy) * fx;
+		float bottom = height_at(ix, iy + 1) * (1.0f - fx) + height_at(ix + 1, iy + 1) * fx;
+		out[i] = top * (1.0f - fy) + bottom * fy;
+	}
+}
@@ -0,0 +1,310 @@
+#include "ocean_fft.h"
+#include "thread_pool.h"
+
+#include <cassert>
+#include <cmath>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+//Compile time selected vector type, every strip row is STRIP floats wide
+namespace {
+#if defined(__AVX2__)
+	struct Vec {
+		static constexpr int width = 8;
+		__m256 v;
+	};
+	inline Vec Load(const float* p) { return { _mm256_loadu_ps(p) }; }
+	inline void Store(float* p, Vec a) { _mm256_storeu_ps(p, a.v); }
+	inline Vec Set1(float s) { return { _mm256_set1_ps(s) }; }
+	inline Vec Add(Vec a, Vec b) { return { _mm256_add_ps(a.v, b.v) }; }
+	inline Vec Sub(Vec a, Vec b) { return { _mm256_sub_ps(a.v, b.v) }; }
+	inline Vec Mul(Vec a, Vec b) { return { _mm256_mul_ps(a.v, b.v) }; }
+	inline Vec MulAdd(Vec a, Vec b, Vec c) { return { _mm256_fmadd_ps(a.v, b.v, c.v) }; }
+	inline Vec MulSub(Vec a, Vec b, Vec c) { return { _mm256_fmsub_ps(a.v, b.v, c.v) }; }
+	const char* SIMD_NAME = "AVX2";
+#elif defined(__ARM_NEON)
+	struct Vec {
+		static constexpr int width = 4;
+		float32x4_t v;
+	};
+	inline Vec Load(const float* p) { return { vld1q_f32(p) }; }
+	inline void Store(float* p, Vec a) { vst1q_f32(p, a.v); }
+	inline Vec Set1(float s) { return { vdupq_n_f32(s) }; }
+	inline Vec Add(Vec a, Vec b) { return { vaddq_f32(a.v, b.v) }; }
+	inline Vec Sub(Vec a, Vec b) { return { vsubq_f32(a.v, b.v) }; }
+	inline Vec Mul(Vec a, Vec b) { return { vmulq_f32(a.v, b.v) }; }
+	inline Vec MulAdd(Vec a, Vec b, Vec c) { return { vmlaq_f32(c.v, a.v, b.v) }; }
+	inline Vec MulSub(Vec a, Vec b, Vec c) { return { vnegq_f32(vmlsq_f32(c.v, a.v, b.v)) }; }
+	const char* SIMD_NAME = "NEON";
+#else
+	struct Vec {
+		static constexpr int width = 1;
+		float v;
+	};
+	inline Vec Load(const float* p) { return { *p }; }
+	inline void Store(float* p, Vec a) { *p = a.v; }
+	inline Vec Set1(float s) { return { s }; }
+	inline Vec Add(Vec a, Vec b) { return { a.v + b.v }; }
+	inline Vec Sub(Vec a, Vec b) { return { a.v - b.v }; }
+	inline Vec Mul(Vec a, Vec b) { return { a.v * b.v }; }
+	inline Vec MulAdd(Vec a, Vec b, Vec c) { return { a.v * b.v + c.v }; }
+	inline Vec MulSub(Vec a, Vec b, Vec c) { return { a.v * b.v - c.v }; }
+	const char* SIMD_NAME = "scalar";
+#endif
+
+	static_assert(OceanFFT::STRIP % Vec::width == 0, "strip must be a whole number of vectors");
+
+	//(xr + i xi) * (wr + i wi)
+	inline void ComplexMult(Vec xr, Vec xi, Vec wr, Vec wi, Vec& out_r, Vec& out_i)
+	{
+		out_r = MulSub(xr, wr, Mul(xi, wi));
+		out_i = MulAdd(xr, wi, Mul(xi, wr));
+	}
+
+	struct Scratch {
+		std::vector<float> re;
+		std::vector<float> im;
+	};
+
+	Scratch& ThreadScratch(size_t floats)
+	{
+		thread_local Scratch scratch;
+		if (scratch.re.size() < floats)
+		{
+			scratch.re.resize(floats);
+			scratch.im.resize(floats);
+		}
+		return scratch;
+	}
+}
+
+OceanFFT::OceanFFT(int resolution)
+	: N(resolution)
+{
+	assert(resolution >= STRIP && (resolution & (resolution - 1)) == 0);
+
+	int log_size = 0;
+	while ((1 << log_size) < N)
+		log_size++;
+
+	bit_reverse.resize(N);
+	for (int i = 0; i < N; i++)
+	{
+		uint32_t reversed = 0;
+		for (int bit = 0; bit < log_size; bit++)
+			reversed |= ((uint32_t(i) >> bit) & 1u) << (log_size - 1 - bit);
+		bit_reverse[i] = reversed;
+	}
+
+	//An odd number of radix-2 stages leaves one trivial radix-2 pass at the front
+	int span = 1;
+	if (log_size % 2 == 1)
+	{
+		passes.push_back({ 1, false, 0 });
+		span = 2;
+	}
+
+	const double two_pi = 6.283185307179586;
+	for (; span < N; span *= 4)
+	{
+		Pass pass{ span, true, twiddle_re.size() };
+		for (int power = 1; power <= 3; power++)
+		{
+			for (int j = 0; j < span; j++)
+			{
+				double angle = two_pi * double(power * j) / double(4 * span);
+				twiddle_re.push_back(float(std::cos(angle)));
+				twiddle_im.push_back(float(std::sin(angle)));
+			}
+		}
+		passes.push_back(pass);
+	}
+}
+
+const char* OceanFFT::SimdName()
+{
+	return SIMD_NAME;
+}
+
+void OceanFFT::TransformStrip(float* re, float* im) const
+{
+	const int W = STRIP;
+
+	for (const Pass& pass : passes)
+	{
+		const int m = pass.span;
+		if (!pass.radix4)
+		{
+			for (int base = 0; base < N; base += 2)
+			{
+				float* r0 = re + size_t(base) * W;
+				float* i0 = im + size_t(base) * W;
+				for (int l = 0; l < W; l += Vec::width)
+				{
+					Vec ar = Load(r0 + l), ai = Load(i0 + l);
+					Vec br = Load(r0 + W + l), bi = Load(i0 + W + l);
+					Store(r0 + l, Add(ar, br));
+					Store(i0 + l, Add(ai, bi));
+					Store(r0 + W + l, Sub(ar, br));
+					Store(i0 + W + l, Sub(ai, bi));
+				}
+			}
+			continue;
+		}
+
+		const float* w1r = twiddle_re.data() + pass.twiddle_offset;
+		const float* w1i = twiddle_im.data() + pass.twiddle_offset;
+		const float* w2r = w1r + m;
+		const float* w2i = w1i + m;
+		const float* w3r = w2r + m;
+		const float* w3i = w2i + m;
+
+		for (int base = 0; base < N; base += 4 * m)
+		{
+			for (int j = 0; j < m; j++)
+			{
+				Vec t1r = Set1(w1r[j]), t1i = Set1(w1i[j]);
+				Vec t2r = Set1(w2r[j]), t2i = Set1(w2i[j]);
+				Vec t3r = Set1(w3r[j]), t3i = Set1(w3i[j]);
+
+				float* r0 = re + size_t(base + j) * W;
+				float* i0 = im + size_t(base + j) * W;
+				float* r1 = r0 + size_t(m) * W;
+				float* i1 = i0 + size_t(m) * W;
+				float* r2 = r1 + size_t(m) * W;
+				float* i2 = i1 + size_t(m) * W;
+				float* r3 = r2 + size_t(m) * W;
+				float* i3 = i2 + size_t(m) * W;
+
+				for (int l = 0; l < W; l += Vec::width)
+				{
+					//Two radix-2 stages fused: x1 takes W^2j, x2 takes W^j and x3 takes W^3j
+					Vec ar = Load(r0 + l), ai = Load(i0 + l);
+					Vec br, bi, cr, ci, dr, di;
+					ComplexMult(Load(r1 + l), Load(i1 + l), t2r, t2i, br, bi);
+					ComplexMult(Load(r2 + l), Load(i2 + l), t1r, t1i, cr, ci);
+					ComplexMult(Load(r3 + l), Load(i3 + l), t3r, t3i, dr, di);
+
+					Vec s0r = Add(ar, br), s0i = Add(ai, bi);
+					Vec s1r = Sub(ar, br), s1i = Sub(ai, bi);
+					Vec s2r = Add(cr, dr), s2i = Add(ci, di);
+					Vec s3r = Sub(cr, dr), s3i = Sub(ci, di);
+
+					Store(r0 + l, Add(s0r, s2r));
+					Store(i0 + l, Add(s0i, s2i));
+					Store(r2 + l, Sub(s0r, s2r));
+					Store(i2 + l, Sub(s0i, s2i));
+					//Multiplying by i rotates (s3r, s3i) into (-s3i, s3r)
+					Store(r1 + l, Sub(s1r, s3i));
+					Store(i1 + l, Add(s1i, s3r));
+					Store(r3 + l, Add(s1r, s3i));
+					Store(i3 + l, Sub(s1i, s3r));
+				}
+			}
+		}
+	}
+}
+
+void OceanFFT::Inverse2D(float* const* re, float* const* im, size_t field_count, ThreadPool* pool) const
+{
+	InverseRows(re, im, field_count, pool);
+	InverseColumns(re, im, field_count, pool);
+}
+
+void OceanFFT::InverseRows(float* const* re, float* const* im, size_t field_count, ThreadPool* pool) const
+{
+	const int W = STRIP;
+	const size_t strips = size_t(N / W);
+	const size_t stride = size_t(N);
+
+	//Horizontal pass: gather STRIP rows transposed so the transform runs down the scratch
+	auto row_strip = [&](size_t item) {
+		size_t field = item / strips;
+		size_t row0 = (item % strips) * W;
+		Scratch& scratch = ThreadScratch(size_t(N) * W);
+
+		for (int l = 0; l < W; l++)
+		{
+			const float* src_r = re[field] + (row0 + l) * stride;
+			const float* src_i = im[field] + (row0 + l) * stride;
+			for (int x = 0; x < N; x++)
+			{
+				scratch.re[size_t(bit_reverse[x]) * W + l] = src_r[x];
+				scratch.im[size_t(bit_reverse[x]) * W + l] = src_i[x];
+			}
+		}
+
+		TransformStrip(scratch.re.data(), scratch.im.data());
+
+		for (int l = 0; l < W; l++)
+		{
+			float* dst_r = re[field] + (row0 + l) * stride;
+			float* dst_i = im[field] + (row0 + l) * stride;
+			for (int x = 0; x < N; x++)
+			{
+				dst_r[x] = scratch.re[size_t(x) * W + l];
+				dst_i[x] = scratch.im[size_t(x) * W + l];
+			}
+		}
+	};
+
+	const size_t items = field_count * strips;
+	if (pool)
+		pool->ParallelFor(items, row_strip);
+	else
+		for (size_t item = 0; item < items; item++)
+			row_strip(item);
+}
+
+void OceanFFT::InverseColumns(float* const* re, float* const* im, size_t field_count, ThreadPool* pool) const
+{
+	const int W = STRIP;
+	const size_t strips = size_t(N / W);
+	const size_t stride = size_t(N);
+
+	//Vertical pass: STRIP neighbouring columns are already contiguous in every row
+	auto column_strip = [&](size_t item) {
+		size_t field = item / strips;
+		size_t column0 = (item % strips) * W;
+		Scratch& scratch = ThreadScratch(size_t(N) * W);
+
+		for (int y = 0; y < N; y++)
+		{
+			const float* src_r = re[field] + size_t(y) * stride + column0;
+			const float* src_i = im[field] + size_t(y) * stride + column0;
+			float* dst_r = scratch.re.data() + size_t(bit_reverse[y]) * W;
+			float* dst_i = scratch.im.data() + size_t(bit_reverse[y]) * W;
+			for (int l = 0; l < W; l += Vec::width)
+			{
+				Store(dst_r + l, Load(src_r + l));
+				Store(dst_i + l, Load(src_i + l));
+			}
+		}
+
+		TransformStrip(scratch.re.data(), scratch.im.data());
+
+		for (int y = 0; y < N; y++)
+		{
+			float* dst_r = re[field] + size_t(y) * stride + column0;
+			float* dst_i = im[field] + size_t(y) * stride + column0;
+			const float* src_r = scratch.re.data() + size_t(y) * W;
+			const float* src_i = scratch.im.data() + size_t(y) * W;
+			for (int l = 0; l < W; l += Vec::width)
+			{
+				Store(dst_r + l, Load(src_r + l));
+				Store(dst_i + l, Load(src_i + l));
+			}
+		}
+	};
+
+	const size_t items = field_count * strips;
+	if (pool)
+		pool->ParallelFor(items, column_strip);
+	else
+		for (size_t item = 0; item < items; item++)
+			column_strip(item);
+}
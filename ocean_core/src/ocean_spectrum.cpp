@@ -0,0 +1,286 @@
+#include "ocean_spectrum.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <cmath>
+
+//Straight port of initial_spectrum.comp, kept in single precision so both paths agree
+namespace {
+	const float PI = 3.14159265359f;
+	const float g = 9.81f;
+
+	struct SpectrumContext {
+		const OceanParams& params;
+		float omega_peak;
+	};
+
+	//PCG output permutation, the counter based hash of initial_spectrum.comp
+	uint32_t Hash(uint32_t value)
+	{
+		uint32_t state = value * 747796405u + 2891336453u;
+		uint32_t word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+		return (word >> 22u) ^ word;
+	}
+
+	//Modes are counted on a grid of MAX_FFT_RESOLUTION of the GPU path, the same wave gets the same noise at every resolution
+	const int NOISE_GRID = 4096;
+
+	//Box-Muller on two hashed counters, a standard normal pair per mode
+	void GaussianNoise(uint64_t seed, uint32_t texel, float& a, float& b)
+	{
+		uint32_t key = Hash(uint32_t(seed) + Hash(uint32_t(seed >> 32)));
+		float u1 = (float(Hash(2u * texel + key) >> 8) + 0.5f) / 16777216.0f;
+		float u2 = (float(Hash(2u * texel + 1u + key) >> 8) + 0.5f) / 16777216.0f;
+		float radius = std::sqrt(-2.0f * std::log(u1));
+		a = radius * std::cos(2.0f * PI * u2);
+		b = radius * std::sin(2.0f * PI * u2);
+	}
+
+	float DispersionPeak(const OceanParams& params)
+	{
+		if (params.spectrum == OceanParams::Spectrum::JONSWAP)
+			return 22.0f * std::pow(g * g / (params.wind_speed * params.fetch), 0.33f);
+		return 0.855f * g / params.wind_speed;
+	}
+
+	float DispersionDerivative(float kLength)
+	{
+		return g / (2.0f * std::sqrt(g * kLength));
+	}
+
+	float GammaApprox(float x)
+	{
+		float firstPart = std::sqrt(2.0f * PI / x) * std::pow(x / std::exp(1.0f), x);
+		float secondPart = 1.0f + 1.0f / (12.0f * x) + 1.0f / (288.0f * x * x) - 139.0f / (51840.0f * x * x * x) - 571.0f / (2488320.0f * x * x * x * x);
+		return firstPart * secondPart;
+	}
+
+	float NormalizationFactor(float s)
+	{
+		float firstPart = std::pow(2.0f, 2.0f * s - 1.0f) / PI;
+		float secondPart = std::pow(GammaApprox(s + 1.0f), 2.0f) / GammaApprox(2.0f * s + 1.0f);
+		return firstPart * secondPart;
+	}
+
+	float WaveAngle(const OceanParams& params, float k_x, float k_z)
+	{
+		const float windAngle = params.wind_angle / 180.0f * PI;
+		float angle = std::atan2(k_z, k_x) - windAngle;
+
+		//Normalize the angle to the range [-PI, PI]
+		angle = (angle + PI) - 2.0f * PI * std::floor((angle + PI) / (2.0f * PI));
+		if (angle < 0)
+			angle += 2.0f * PI;
+		return angle - PI;
+	}
+
+	float TMACorrection(const OceanParams& params, float dispersion)
+	{
+		float omegaH = dispersion * std::sqrt(params.depth / g);
+
+		if (omegaH <= 1.0f)
+			return 0.5f * omegaH * omegaH;
+		if (omegaH < 2.0f)
+			return 1.0f - 0.5f * (2.0f - omegaH) * (2.0f - omegaH);
+
+		return 1.0f;
+	}
+
+	float JONSWAP(const SpectrumContext& ctx, float dispersion)
+	{
+		float wind_speed = ctx.params.wind_speed;
+		float alpha = 0.076f * std::pow(wind_speed * wind_speed / (ctx.params.fetch * g), 0.22f);
+		float omega_p = ctx.omega_peak;
+		float sigma = dispersion <= omega_p ? 0.07f : 0.09f;
+		float r = std::exp(-(dispersion - omega_p) * (dispersion - omega_p) / (2.0f * sigma * sigma * omega_p * omega_p));
+
+		float firstPart = alpha * g * g / (dispersion * dispersion * dispersion * dispersion * dispersion);
+		float secondPart = std::exp(-1.25f * std::pow(omega_p / dispersion, 4.0f));
+		float thirdPart = std::pow(3.3f, r);
+
+		return firstPart * secondPart * thirdPart;
+	}
+
+	float PiersonMoskowitz(const SpectrumContext& ctx, float dispersion)
+	{
+		float firstPart = 0.0081f * g * g / (dispersion * dispersion * dispersion * dispersion * dispersion);
+		return firstPart * std::exp(-1.25f * std::pow(ctx.omega_peak / dispersion, 4.0f));
+	}
+
+	//Over k, converted to a frequency spectrum like the other two
+	float Phillips(const SpectrumContext& ctx, float kLength)
+	{
+		float L = ctx.params.wind_speed * ctx.params.wind_speed / g;
+		float kL = kLength * L;
+		float phillipsK = 0.5f * 0.0081f * std::exp(-1.0f / (kL * kL)) / (kLength * kLength * kLength);
+		return phillipsK / DispersionDerivative(kLength);
+	}
+
+	float OmnidirectionalSpectrum(const SpectrumContext& ctx, float kLength, float dispersion)
+	{
+		float spectrum;
+		if (ctx.params.spectrum == OceanParams::Spectrum::Phillips)
+			spectrum = Phillips(ctx, kLength);
+		else if (ctx.params.spectrum == OceanParams::Spectrum::PiersonMoskowitz)
+			spectrum = PiersonMoskowitz(ctx, dispersion);
+		else
+			spectrum = JONSWAP(ctx, dispersion);
+
+		if (ctx.params.tma_depth)
+			spectrum *= TMACorrection(ctx.params, dispersion);
+		return spectrum;
+	}
+
+	float CosineSquaredSpread(float angle)
+	{
+		if (std::abs(angle) >= PI / 2.0f)
+			return 0.0f;
+		float c = std::cos(angle);
+		return 2.0f / PI * c * c;
+	}
+
+	//Angle independent parts of BaseSpread and SwellDirection, hoisted out of the integration loop
+	struct SpreadTerms {
+		float beta;
+		float base_scale;
+		float s;
+		float swell_scale;
+	};
+
+	SpreadTerms DirectionalSpreadTerms(const SpectrumContext& ctx, float dispersion)
+	{
+		float omegaOverOmegaPeek = dispersion / ctx.omega_peak;
+		SpreadTerms terms;
+
+		if (omegaOverOmegaPeek < 0.95f)
+		{
+			terms.beta = 2.61f * std::pow(omegaOverOmegaPeek, 1.3f);
+		}
+		else if (omegaOverOmegaPeek <= 1.6f)
+		{
+			terms.beta = 2.28f * std::pow(omegaOverOmegaPeek, -1.3f);
+		}
+		else
+		{
+			float epsilon = -0.4f + 0.8393f * std::exp(-0.567f * std::log(omegaOverOmegaPeek * omegaOverOmegaPeek));
+			terms.beta = std::pow(10.0f, epsilon);
+		}
+		terms.base_scale = terms.beta / (2.0f * std::tanh(terms.beta * PI));
+
+		terms.s = 16.0f * std::tanh(ctx.omega_peak / dispersion) * ctx.params.swell * ctx.params.swell;
+		terms.swell_scale = NormalizationFactor(terms.s);
+		return terms;
+	}
+
+	//BaseSpread * SwellDirection
+	float DirectionalSpread(const SpreadTerms& terms, float angle)
+	{
+		float sech = 1.0f / std::cosh(terms.beta * angle);
+		float base = terms.base_scale * (sech * sech);
+		float swell = terms.swell_scale * std::pow(std::abs(std::cos(angle / 2.0f)), 2.0f * terms.s);
+		return base * swell;
+	}
+
+	float IntegratedDirectionalSpread(const SpreadTerms& terms)
+	{
+		float step = 0.01f;
+		float sum = 0.0f;
+		for (float angle = -PI; angle < PI; angle += step)
+		{
+			sum += DirectionalSpread(terms, angle) * step;
+		}
+
+		return 1.0f / sum;
+	}
+
+	template<typename Fn>
+	void ForEachRow(ThreadPool* pool, int rows, const Fn& fn)
+	{
+		if (pool)
+			pool->ParallelFor(size_t(rows), [&](size_t row) { fn(int(row)); });
+		else
+			for (int row = 0; row < rows; row++)
+				fn(row);
+	}
+}
+
+void WaveVector(int resolution, float patch_size, int x, int y, float& k_x, float& k_z)
+{
+	float n = resolution * 0.5f;
+	k_x = 2.0f * PI * (float(x) - n) / patch_size;
+	k_z = 2.0f * PI * (float(y) - n) / patch_size;
+
+	if (std::sqrt(k_x * k_x + k_z * k_z) == 0.0f)
+	{
+		k_x = 0.0001f;
+		k_z = 0.0001f;
+	}
+}
+
+float WaveDispersion(float kLength)
+{
+	return std::sqrt(g * kLength);
+}
+
+void GenerateInitialSpectrum(const OceanParams& params, OceanSpectrum& spectrum, ThreadPool* pool)
+{
+	const int N = params.resolution;
+	const int half = N / 2;
+	const size_t texel_count = size_t(N) * size_t(N);
+
+	spectrum.resolution = N;
+	spectrum.h0_re.assign(texel_count, 0.0f);
+	spectrum.h0_im.assign(texel_count, 0.0f);
+
+	SpectrumContext ctx{ params, DispersionPeak(params) };
+
+	//The angular normalisation only depends on |k|, which is shared by every (+-a, +-b) / (+-b, +-a) texel.
+	//cos^2 is normalised analytically and needs no table
+	const bool donelan = params.spreading == OceanParams::Spreading::DonelanSwell;
+	const int table_size = donelan ? half + 1 : 0;
+	std::vector<float> spread_table(size_t(table_size) * table_size, 0.0f);
+	ForEachRow(pool, table_size, [&](int a) {
+		for (int b = 0; b <= a; b++)
+		{
+			float k_x, k_z;
+			WaveVector(params.resolution, params.patch_size, half + a, half + b, k_x, k_z);
+			float dispersion = WaveDispersion(std::sqrt(k_x * k_x + k_z * k_z));
+			spread_table[size_t(a) * table_size + b] = IntegratedDirectionalSpread(DirectionalSpreadTerms(ctx, dispersion));
+		}
+	});
+
+	ForEachRow(pool, N, [&](int y) {
+		for (int x = 0; x < N; x++)
+		{
+			size_t index = size_t(y) * N + x;
+			float k_x, k_z;
+			WaveVector(params.resolution, params.patch_size, x, y, k_x, k_z);
+			float kLength = std::sqrt(k_x * k_x + k_z * k_z);
+			float dispersion = WaveDispersion(kLength);
+			float angle = WaveAngle(params, k_x, k_z);
+
+			float spread;
+			if (donelan)
+			{
+				int a = std::abs(x - half);
+				int b = std::abs(y - half);
+				float integration = spread_table[size_t(std::max(a, b)) * table_size + std::min(a, b)];
+				spread = integration * DirectionalSpread(DirectionalSpreadTerms(ctx, dispersion), angle);
+			}
+			else
+			{
+				spread = CosineSquaredSpread(angle);
+			}
+			float spectrum_value = OmnidirectionalSpectrum(ctx, kLength, dispersion) * spread * DispersionDerivative(kLength) / kLength;
+
+			float deltaK = 2.0f * PI / params.patch_size;
+			float amplitude = std::sqrt(2.0f * spectrum_value * deltaK * deltaK);
+
+			float noise_re, noise_im;
+			uint32_t mode = uint32_t((y - half + NOISE_GRID / 2) * NOISE_GRID + x - half + NOISE_GRID / 2);
+			GaussianNoise(params.seed, mode, noise_re, noise_im);
+			spectrum.h0_re[index] = noise_re * amplitude;
+			spectrum.h0_im[index] = noise_im * amplitude;
+		}
+	});
+}
@@ -1,8 +1,11 @@
 #include "sim_utils.h"
 #include <iostream>
-double getHeight(const double x, const double y, const double t, FFTRenderer* fft_simulator)
+#include <vector>
+double getHeight(const double x, const double y, const double t, OceanHeightQuery* fft_simulator)
 {
-    float h = fft_simulator->GetHeightValues(x, y, t);
+    OceanPoint point{ float(x), float(y) };
+    float h = 0.0f;
+    fft_simulator->GetHeights(&point, 1, t, &h);
     return h;
 }
 
@@ -23,14 +26,24 @@ Eigen::MatrixXd createFEMElements()
     return elementVertices;
 }
 
-Eigen::VectorXd calculateWaveHeights (const Eigen::MatrixXd& elementVertices, const double simTime, FFTRenderer* fft_simulator)
+Eigen::VectorXd calculateWaveHeights (const Eigen::MatrixXd& elementVertices, const double simTime, OceanHeightQuery* fft_simulator)
 {
     Eigen::VectorXd waveHeights (elementVertices.cols());       // Number of wave height data points == number of vertices
 
+    // Gather every vertex so the simulator answers them in a single query
+    std::vector<OceanPoint> points (elementVertices.cols());
     for (unsigned int col = 0; col < elementVertices.cols(); col++)
     {
         const Eigen::Vector3d vertex = elementVertices.col(col);
-        waveHeights[col] = getHeight(vertex.x(), vertex.y(), simTime,fft_simulator);
+        points[col] = OceanPoint{ float(vertex.x()), float(vertex.y()) };
+    }
+
+    std::vector<float> heights (points.size());
+    fft_simulator->GetHeights(points.data(), points.size(), simTime, heights.data());
+
+    for (unsigned int col = 0; col < elementVertices.cols(); col++)
+    {
+        waveHeights[col] = heights[col];
     }
 
     return waveHeights;
@@ -0,0 +1,62 @@
+#include "storage_precision.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+float RoundToHalf(float value)
+{
+	if (!std::isfinite(value))
+		return value;
+
+	float magnitude = std::fabs(value);
+	if (magnitude == 0.0f)
+		return value;
+
+	//Half has 10 mantissa bits and bottoms out at 2^-14, below that the spacing stays 2^-24
+	int exponent = std::max(std::ilogb(magnitude), -14);
+	float spacing = std::ldexp(1.0f, exponent - 10);
+	float rounded = std::nearbyint(magnitude / spacing) * spacing;
+	if (rounded > 65504.0f)
+		rounded = std::numeric_limits<float>::infinity();
+
+	return std::copysign(rounded, value);
+}
+
+DisplacementError CompareDisplacementMaps(const float* reference, const float* test, size_t texel_count)
+{
+	//RGBA texel channel of each reported component
+	const int channels[3] = { 0, 1, 2 };
+
+	DisplacementError error;
+	error.texel_count = texel_count;
+	for (size_t texel = 0; texel < texel_count; texel++)
+	{
+		for (int c = 0; c < 3; c++)
+		{
+			double expected = reference[texel * 4 + channels[c]];
+			double difference = double(test[texel * 4 + channels[c]]) - expected;
+			error.max_abs[c] = std::max(error.max_abs[c], std::fabs(difference));
+			error.rms[c] += difference * difference;
+			error.reference_rms[c] += expected * expected;
+		}
+	}
+
+	for (int c = 0; c < 3; c++)
+	{
+		error.rms[c] = texel_count ? std::sqrt(error.rms[c] / double(texel_count)) : 0.0;
+		error.reference_rms[c] = texel_count ? std::sqrt(error.reference_rms[c] / double(texel_count)) : 0.0;
+	}
+	return error;
+}
+
+void PrintDisplacementError(std::ostream& out, const DisplacementError& error)
+{
+	const char* names[3] = { "choppy x", "height  ", "choppy z" };
+	for (int c = 0; c < 3; c++)
+	{
+		double relative = error.reference_rms[c] > 0.0 ? error.rms[c] / error.reference_rms[c] : 0.0;
+		out << names[c] << "  max abs " << error.max_abs[c] << "  rms " << error.rms[c]
+			<< "  rms / signal rms " << relative << std::endl;
+	}
+}
@@ -0,0 +1,78 @@
+#include "thread_pool.h"
+
+ThreadPool::ThreadPool(unsigned int thread_count)
+{
+	//The caller works too, so only spawn the remaining threads
+	unsigned int extra = thread_count > 1 ? thread_count - 1 : 0;
+	for (unsigned int i = 0; i < extra; i++)
+		workers.emplace_back([this]() { WorkerLoop(); });
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	job_ready.notify_all();
+	for (auto& worker : workers)
+		worker.join();
+}
+
+void ThreadPool::ParallelFor(size_t count, const std::function<void(size_t)>& fn)
+{
+	if (count == 0)
+		return;
+
+	if (workers.empty() || count == 1)
+	{
+		for (size_t i = 0; i < count; i++)
+			fn(i);
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		job = &fn;
+		job_count = count;
+		next_item = 0;
+		busy_workers = unsigned(workers.size());
+		generation++;
+	}
+	job_ready.notify_all();
+
+	RunItems();
+
+	std::unique_lock<std::mutex> lock(mutex);
+	job_done.wait(lock, [this]() { return busy_workers == 0; });
+	job = nullptr;
+}
+
+void ThreadPool::WorkerLoop()
+{
+	uint64_t seen_generation = 0;
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			job_ready.wait(lock, [&]() { return stopping || generation != seen_generation; });
+			if (stopping)
+				return;
+			seen_generation = generation;
+		}
+
+		RunItems();
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (--busy_workers == 0)
+				job_done.notify_one();
+		}
+	}
+}
+
+void ThreadPool::RunItems()
+{
+	for (size_t i = next_item.fetch_add(1); i < job_count; i = next_item.fetch_add(1))
+		(*job)(i);
+}
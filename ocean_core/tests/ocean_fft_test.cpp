@@ -0,0 +1,130 @@
+#include "ocean_fft.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <vector>
+
+namespace {
+	//Naive inverse DFT along rows then columns, in double, same sign and scaling as OceanFFT
+	void ReferenceInverse2D(int N, std::vector<double>& re, std::vector<double>& im)
+	{
+		const double two_pi = 6.283185307179586;
+		std::vector<double> cos_table(N), sin_table(N);
+		for (int i = 0; i < N; i++)
+		{
+			cos_table[i] = std::cos(two_pi * double(i) / double(N));
+			sin_table[i] = std::sin(two_pi * double(i) / double(N));
+		}
+
+		std::vector<double> in_re(N), in_im(N), line_re(N), line_im(N);
+		auto transform = [&](size_t offset, size_t stride) {
+			for (int x = 0; x < N; x++)
+			{
+				in_re[x] = re[offset + size_t(x) * stride];
+				in_im[x] = im[offset + size_t(x) * stride];
+			}
+			for (int k = 0; k < N; k++)
+			{
+				double sum_re = 0.0, sum_im = 0.0;
+				//Twiddle index k * x mod N, N is a power of two
+				int w = 0;
+				for (int x = 0; x < N; x++, w = (w + k) & (N - 1))
+				{
+					sum_re += in_re[x] * cos_table[w] - in_im[x] * sin_table[w];
+					sum_im += in_re[x] * sin_table[w] + in_im[x] * cos_table[w];
+				}
+				line_re[k] = sum_re;
+				line_im[k] = sum_im;
+			}
+			for (int k = 0; k < N; k++)
+			{
+				re[offset + size_t(k) * stride] = line_re[k];
+				im[offset + size_t(k) * stride] = line_im[k];
+			}
+		};
+
+		for (int y = 0; y < N; y++)
+			transform(size_t(y) * N, 1);
+		for (int x = 0; x < N; x++)
+			transform(size_t(x), size_t(N));
+	}
+
+	//Largest error of any output against the reference, relative to the reference RMS, once
+	//serial and once split over the pool
+	bool CheckResolution(int N, ThreadPool& pool)
+	{
+		const size_t field_count = 2;
+		const size_t texels = size_t(N) * N;
+
+		std::mt19937 rng{ uint32_t(N) };
+		std::uniform_real_distribution<float> value(-1.0f, 1.0f);
+
+		std::vector<std::vector<float>> re(field_count, std::vector<float>(texels));
+		std::vector<std::vector<float>> im(field_count, std::vector<float>(texels));
+		for (size_t field = 0; field < field_count; field++)
+		{
+			for (size_t i = 0; i < texels; i++)
+			{
+				re[field][i] = value(rng);
+				im[field][i] = value(rng);
+			}
+		}
+
+		std::vector<std::vector<double>> expected_re(field_count), expected_im(field_count);
+		for (size_t field = 0; field < field_count; field++)
+		{
+			expected_re[field].assign(re[field].begin(), re[field].end());
+			expected_im[field].assign(im[field].begin(), im[field].end());
+			ReferenceInverse2D(N, expected_re[field], expected_im[field]);
+		}
+
+		double signal = 0.0;
+		for (size_t field = 0; field < field_count; field++)
+			for (size_t i = 0; i < texels; i++)
+				signal += expected_re[field][i] * expected_re[field][i] + expected_im[field][i] * expected_im[field][i];
+		const double signal_rms = std::sqrt(signal / double(2 * field_count * texels));
+
+		const OceanFFT fft(N);
+		bool passed = true;
+		for (ThreadPool* run_pool : { (ThreadPool*)nullptr, &pool })
+		{
+			std::vector<std::vector<float>> out_re = re, out_im = im;
+			float* re_ptrs[field_count] = { out_re[0].data(), out_re[1].data() };
+			float* im_ptrs[field_count] = { out_im[0].data(), out_im[1].data() };
+			fft.Inverse2D(re_ptrs, im_ptrs, field_count, run_pool);
+
+			double max_error = 0.0;
+			for (size_t field = 0; field < field_count; field++)
+			{
+				for (size_t i = 0; i < texels; i++)
+				{
+					max_error = std::max(max_error, std::fabs(out_re[field][i] - expected_re[field][i]));
+					max_error = std::max(max_error, std::fabs(out_im[field][i] - expected_im[field][i]));
+				}
+			}
+			double relative = max_error / signal_rms;
+
+			//float rounding grows with log N, 1e-5 of the signal RMS leaves ten times headroom at 512
+			bool run_passed = relative < 1e-5;
+			std::cout << "N " << N << (run_pool ? " pooled" : " serial") << "  max abs " << max_error
+				<< "  max abs / signal rms " << relative << (run_passed ? "" : "  FAILED") << std::endl;
+			passed &= run_passed;
+		}
+		return passed;
+	}
+}
+
+int main()
+{
+	std::cout << "OceanFFT::Inverse2D against a naive DFT (" << OceanFFT::SimdName() << ")" << std::endl;
+
+	ThreadPool pool(4);
+	bool passed = true;
+	//64 and 256 are pure radix-4, 128 and 512 start with the radix-2 pass
+	for (int N : { 64, 128, 256, 512 })
+		passed &= CheckResolution(N, pool);
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,90 @@
+#include "cpu_ocean.h"
+#include "storage_precision.h"
+
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <vector>
+
+namespace {
+	bool Expect(bool condition, const char* what)
+	{
+		if (!condition)
+			std::cout << "FAILED: " << what << std::endl;
+		return condition;
+	}
+
+	bool CheckRounding()
+	{
+		const float inf = std::numeric_limits<float>::infinity();
+		bool passed = true;
+		passed &= Expect(RoundToHalf(1.0f) == 1.0f, "1 is exact");
+		passed &= Expect(RoundToHalf(65504.0f) == 65504.0f, "largest half is exact");
+		passed &= Expect(RoundToHalf(65520.0f) == inf, "past the largest half rounds to infinity");
+		passed &= Expect(RoundToHalf(-65520.0f) == -inf, "sign survives the overflow");
+		passed &= Expect(RoundToHalf(1.0f + std::ldexp(1.0f, -11)) == 1.0f, "tie rounds down to even");
+		passed &= Expect(RoundToHalf(1.0f + 3.0f * std::ldexp(1.0f, -11)) == 1.0f + std::ldexp(1.0f, -9), "tie rounds up to even");
+		passed &= Expect(RoundToHalf(-0.1f) == -0.0999755859375f, "-0.1 takes the nearest half");
+		passed &= Expect(RoundToHalf(std::ldexp(1.0f, -24)) == std::ldexp(1.0f, -24), "smallest subnormal is exact");
+		passed &= Expect(RoundToHalf(std::ldexp(1.0f, -26)) == 0.0f, "below half the smallest subnormal flushes to zero");
+		passed &= Expect(std::isnan(RoundToHalf(std::nanf(""))), "NaN stays NaN");
+		return passed;
+	}
+
+	bool CheckReport()
+	{
+		//Two texels, the test map is off by 1 in x on the first and by 2 in z on the second
+		const float reference[8] = { 3.0f, 1.0f, 0.0f, 1.0f, 4.0f, -1.0f, 0.0f, 1.0f };
+		const float test[8] = { 4.0f, 1.0f, 0.0f, 1.0f, 4.0f, -1.0f, 2.0f, 1.0f };
+		DisplacementError error = CompareDisplacementMaps(reference, test, 2);
+
+		bool passed = true;
+		passed &= Expect(error.texel_count == 2, "texel count");
+		passed &= Expect(error.max_abs[0] == 1.0 && error.max_abs[1] == 0.0 && error.max_abs[2] == 2.0, "max abs per channel");
+		passed &= Expect(std::fabs(error.rms[0] - std::sqrt(0.5)) < 1e-12 && std::fabs(error.rms[2] - std::sqrt(2.0)) < 1e-12, "rms per channel");
+		passed &= Expect(std::fabs(error.reference_rms[0] - std::sqrt(12.5)) < 1e-12 && error.reference_rms[1] == 1.0, "reference rms per channel");
+
+		std::ostringstream report;
+		PrintDisplacementError(report, error);
+		passed &= Expect(report.str().find("height") != std::string::npos, "report names the height channel");
+		return passed;
+	}
+
+	//Same comparison main_app prints, with a bound on it
+	bool CheckOceanError()
+	{
+		OceanParams params;
+		params.seed = 1;
+		params.resolution = 256;
+		OceanParams half_params = params;
+		half_params.half_precision_storage = true;
+
+		CPUOceanSimulator ocean(params);
+		CPUOceanSimulator half_ocean(half_params);
+		ocean.Simulate(5.0);
+		half_ocean.Simulate(5.0);
+
+		DisplacementError error = CompareDisplacementMaps(ocean.DisplacementMap().data(), half_ocean.DisplacementMap().data(),
+			size_t(params.resolution) * size_t(params.resolution));
+		std::cout << "FP16 storage vs FP32 displacement map at t = 5:" << std::endl;
+		PrintDisplacementError(std::cout, error);
+
+		bool passed = true;
+		for (int c = 0; c < 3; c++)
+		{
+			passed &= Expect(error.reference_rms[c] > 0.0, "reference map is not flat");
+			passed &= Expect(error.rms[c] > 0.0, "FP16 storage changes the map");
+			passed &= Expect(error.rms[c] < 1e-2 * error.reference_rms[c], "FP16 error stays under 1% of the signal");
+		}
+		return passed;
+	}
+}
+
+int main()
+{
+	bool passed = CheckRounding();
+	passed &= CheckReport();
+	passed &= CheckOceanError();
+	return passed ? 0 : 1;
+}